@@ -8,7 +8,7 @@ SET( SUBDIRS		src )
 SET( PLUGINNAME		"ncurses" )
 SET( LIB_DEPS		Curses6)
 SET( INTERNAL_DEPS	Libyui )
-SET( LIB_LINKER		)
+SET( LIB_LINKER		pthread )
 SET( URL		"http://github.com/libyui/" )
 SET( SUMMARY		"Libyui - Character Based User Interface" )
 SET( DESCRIPTION	"This package contains the character based (ncurses) user interface\ncomponent for libYUI.\n" )
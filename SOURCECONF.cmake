@@ -10,6 +10,7 @@ SET( ${TARGETLIB}_SOURCES
 
   NCtext.cc
   NCstring.cc
+  NCwidth.cc
   stringutil.cc
   lang2encoding.cc
   ncursesw.cc
@@ -85,6 +86,7 @@ SET( ${TARGETLIB}_HEADERS
   NCPackageSelectorPluginIf.h
   NCtext.h
   NCstring.h
+  NCwidth.h
   stringutil.h
   ncursesw.h
   ncursesp.h
@@ -97,6 +99,7 @@ SET( ${TARGETLIB}_HEADERS
   NCButtonBox.h
   NCTreePad.h
   NCTablePad.h
+  NCTableModel.h
   NCTextPad.h
   NCWidget.h
   NCDialog.h
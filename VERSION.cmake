@@ -1,6 +1,6 @@
 SET( VERSION_MAJOR "2" )
-SET( VERSION_MINOR "48" )
-SET( VERSION_PATCH "1" )
+SET( VERSION_MINOR "49" )
+SET( VERSION_PATCH "0" )
 SET( VERSION "${VERSION_MAJOR}.${VERSION_MINOR}.${VERSION_PATCH}${GIT_SHA1_VERSION}" )
 
 ##### This is need for the libyui core, ONLY.
@@ -19,7 +19,7 @@
 %define so_version 7
 
 Name:           %{parent}-doc
-Version:        2.48.1
+Version:        2.49.0
 Release:        0
 Source:         %{parent}-%{version}.tar.bz2
 
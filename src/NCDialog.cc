@@ -35,6 +35,11 @@
 
 #include "ncursesw.h"
 
+#include <algorithm>
+
+// Input is polled in slices of this length while idle handlers are pending
+#define IDLE_SLICE_MILLISEC 20
+
 
 static bool hiddenMenu()
 {
@@ -805,48 +810,68 @@ wint_t NCDialog::getch( int timeout_millisec )
 {
     wint_t got = WEOF;
 
-    if ( timeout_millisec < 0 )
+    // While there is pending background work, poll for input in short
+    // slices and let the idle handlers proceed in between.
+    while ( got == WEOF && timeout_millisec != 0 && NCurses::HaveIdleHandlers() )
     {
-	// wait for input
-	::nodelay( ::stdscr, false );
-
+	::wtimeout( ::stdscr, IDLE_SLICE_MILLISEC );
 	got = getinput();
 
+	if ( got == WEOF )
+	{
+	    if ( timeout_millisec > 0 )
+		timeout_millisec = std::max( 0, timeout_millisec - IDLE_SLICE_MILLISEC );
+
+	    NCurses::RunIdleHandlers();
+	    doUpdate();
+	}
     }
-    else if ( timeout_millisec )
+
+    if ( got == WEOF )
     {
-	// max halfdelay is 25 seconds (250 tenths of seconds)
-	do
+	if ( timeout_millisec < 0 )
 	{
-	    if ( timeout_millisec > 25000 )
-	    {
-		::halfdelay( 250 );
-		timeout_millisec -= 25000;
-	    }
-	    else
+	    // wait for input
+	    ::nodelay( ::stdscr, false );
+
+	    got = getinput();
+
+	}
+	else if ( timeout_millisec )
+	{
+	    // max halfdelay is 25 seconds (250 tenths of seconds)
+	    do
 	    {
-		if ( timeout_millisec < 100 )
+		if ( timeout_millisec > 25000 )
 		{
-		    // min halfdelay is 1/10 second (100 milliseconds)
-		    ::halfdelay( 1 );
+		    ::halfdelay( 250 );
+		    timeout_millisec -= 25000;
 		}
 		else
-		    ::halfdelay( timeout_millisec / 100 );
+		{
+		    if ( timeout_millisec < 100 )
+		    {
+			// min halfdelay is 1/10 second (100 milliseconds)
+			::halfdelay( 1 );
+		    }
+		    else
+			::halfdelay( timeout_millisec / 100 );
+
+		    timeout_millisec = 0;
+		}
 
-		timeout_millisec = 0;
+		got = getinput();
 	    }
+	    while ( got == WEOF && timeout_millisec > 0 );
 
+	    ::cbreak(); // stop halfdelay
+	}
+	else
+	{
+	    // no wait
+	    ::nodelay( ::stdscr, true );
 	    got = getinput();
 	}
-	while ( got == WEOF && timeout_millisec > 0 );
-
-	::cbreak(); // stop halfdelay
-    }
-    else
-    {
-	// no wait
-	::nodelay( ::stdscr, true );
-	got = getinput();
     }
 
     if ( got == KEY_RESIZE )
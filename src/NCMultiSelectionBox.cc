@@ -95,18 +95,26 @@ void NCMultiSelectionBox::addItem( YItem * item )
     if ( item )
     {
 	YMultiSelectionBox::addItem( item );
-	Items[0] = new NCTableTag( item, item->selected() );
+	Items[0] = new ( myPad()->arena() ) NCTableTag( item, item->selected() );
 
 	// Do not set style to NCTableCol::PLAIN here, otherwise the current
 	//item will not be highlighted if the cursor is not over the widget
 
-	Items[1] = new NCTableCol( item->label() );
+	Items[1] = new ( myPad()->arena() ) NCTableCol( item->label() );
 	myPad()->Append( Items );
 	DrawPad();
     }
 }
 
 
+// Add all items, but redraw just once
+void NCMultiSelectionBox::addItems( const YItemCollection & itemCollection )
+{
+    UpdateGuard batch( *this );
+    YMultiSelectionBox::addItems( itemCollection );
+}
+
+
 /**
  * Return pointer to current line tag
  * (holds state and yitem pointer)
@@ -172,9 +180,11 @@ void NCMultiSelectionBox::deselectAllItems()
 {
     YMultiSelectionBox::deselectAllItems();
 
-    for ( unsigned int i = 0; i < getNumLines(); i++ )
+    // The tags don't change the line format, so there is no need to
+    // ModifyLine() each of them.
+    for ( YItemConstIterator it = itemsBegin(); it != itemsEnd(); ++it )
     {
-	NCTableTag *t = tagCell( i );
+	NCTableTag *t = ( NCTableTag * )( *it )->data();
 	YUI_CHECK_PTR( t );
 
 	t->SetSelected( false );
@@ -69,6 +69,8 @@ public:
 
     virtual void addItem( YItem * item );
 
+    virtual void addItems( const YItemCollection & itemCollection );
+
     virtual void deleteAllItems();
 
     virtual void selectItem( YItem * item, bool selected );
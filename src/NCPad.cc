@@ -26,10 +26,8 @@
 #include <yui/YUILog.h>
 #include "NCPad.h"
 
+#include <algorithm>
 
-// PAD_PAGESIZE needs to be large enough to feed any destwin. We
-// get in throuble here if the terminal has more than 1024 lines.
-#define PAD_PAGESIZE 1024
 
 // Maximum height of the NCursesPad (e.g. in case it can't hold more
 // than 32768 lines). Larger pads need to page.
@@ -37,18 +35,35 @@
 #define MAX_PAD_HEIGHT NCursesWindow::maxcoord()
 
 
-NCPad::NCPad( int lines, int cols, const NCWidget & p )
-  : NCursesPad( lines > MAX_PAD_HEIGHT ? PAD_PAGESIZE : lines, cols )
-  , _vheight( lines > MAX_PAD_HEIGHT ? lines : 0 )
+NCPad::NCPad( int lines, int cols, const NCWidget & p, bool virtualPad )
+  : NCursesPad( ( virtualPad || lines > MAX_PAD_HEIGHT ) ? 1 : lines, cols )
+  , _vheight( lines )
+  , _pageing( virtualPad || lines > MAX_PAD_HEIGHT )
+  , _virtual( virtualPad )
   , parw( p )
   , destwin ( 0 )
   , maxdpos ( 0 )
   , maxspos ( 0 )
   , dclear  ( false )
   , dirty   ( false )
+  , held    ( false )
 {}
 
 
+void NCPad::adjPageHeight()
+{
+    // When pageing, the NCursesPad just needs to hold the lines
+    // visible in destwin (see update()).
+    if ( pageing() && destwin )
+    {
+	int pheight = std::max( 1, std::min( vheight(), destwin->height() ) );
+
+	if ( pheight != height() )
+	    NCursesPad::resize( pheight, width() );
+    }
+}
+
+
 void NCPad::Destwin( NCursesWindow * dwin )
 {
     if ( dwin != destwin )
@@ -57,6 +72,8 @@ void NCPad::Destwin( NCursesWindow * dwin )
 
 	if ( destwin )
 	{
+	    adjPageHeight();
+
 	    wsze mysze( vheight(), width() );
 
 	    drect = wrect( 0, wsze( destwin->height(), destwin->width() ) );
@@ -88,19 +105,22 @@ void NCPad::resize( wsze nsze )
 	if ( odest )
 	    Destwin( 0 );
 
-        if ( nsze.H > MAX_PAD_HEIGHT )
-        {
-          yuiDebug() << "TRUCNATE PAD: " << nsze.H << " > " << MAX_PAD_HEIGHT << std::endl;
-          NCursesPad::resize( PAD_PAGESIZE, nsze.W );
-          _vheight = nsze.H;
-        }
-        else
-        {
-	NCursesPad::resize( nsze.H, nsze.W );
-          _vheight = 0;
-        }
+	if ( _virtual || nsze.H > MAX_PAD_HEIGHT )
+	{
+	    yuiDebug() << "TRUNCATE PAD: " << nsze.H << " (virtual " << _virtual << ")" << std::endl;
+	    // final page height is set as soon as we know the destwin
+	    NCursesPad::resize( std::min( height(), nsze.H ), nsze.W );
+	    _vheight = nsze.H;
+	    _pageing = true;
+	}
+	else
+	{
+	    NCursesPad::resize( nsze.H, nsze.W );
+	    _vheight = 0;
+	    _pageing = false;
+	}
 
-        yuiDebug() << "Pageing ?: " << pageing() << std::endl;
+	yuiDebug() << "Pageing ?: " << pageing() << std::endl;
 
 	if ( odest )
 	    Destwin( odest );
@@ -119,6 +139,12 @@ int NCPad::update()
 {
     if ( destwin )
     {
+	if ( held )
+	{
+	    dirty = true;
+	    return OK;
+	}
+
 	if ( dirty )
 	{
 	    return dirtyPad();
@@ -94,21 +94,30 @@ class NCPad : public NCursesPad, public NCScrollHint
 {
 private:
 
-    /** The real height in case the NCursesPad is truncated, otherwise \c 0.
+    /** The real height in case the NCursesPad is pageing.
      *
      * \note Don't use _vheight directly, but \ref vheight.
      *
      * Up to ncurses5, ncurses uses \c short for window dimensions (can't hold
-     * more than 32768 lines). If \ref resize truncated the window, the real
-     * size is in \ref _vheight. Longer lists need to be paged.
-     *
-     * \todo Once all NCPad based types are able to page, \a maxPadHeight could be
-     * std::set to e.g \c 1024 to avoid bigger widgets in memory. Currently just
-     * \ref NCTablePad supports paging. If paging is \c ON, all content lines are
-     * written via \ref directDraw. Without pageing \ref DoRedraw is reponsible for this.
+     * more than 32768 lines). If \ref resize exceeds this limit, or if the
+     * pad was created \a virtual, the NCursesPad is just large enough to
+     * hold the lines visible in \ref destwin and the real size is in
+     * \ref _vheight. If paging is \c ON, all content lines are written via
+     * \ref directDraw. Without pageing \ref DoRedraw is reponsible for this.
      */
     int   _vheight;
 
+    /** Whether the NCursesPad is truncated (we're pageing). */
+    bool  _pageing;
+
+    /** Whether to page at any size, so memory and redraw costs depend
+     * on the size of \ref destwin rather than on the size of the content.
+     * Requires \ref directDraw to be implemented.
+     */
+    bool  _virtual;
+
+    void adjPageHeight();
+
 protected:
 
     const NCWidget & parw;
@@ -121,12 +130,13 @@ protected:
 
     bool  dclear;
     bool  dirty;
+    bool  held;
 
     /** The (virtual) height of the Pad (even if truncated). */
-    int vheight() const        { return _vheight ? _vheight : height(); }
+    int vheight() const        { return _pageing ? _vheight : height(); }
 
     /** Whether the Pad is truncated (we're pageing). */
-    bool pageing() const { return _vheight; }
+    bool pageing() const { return _pageing; }
 
     virtual int dirtyPad() { dirty = false; return setpos( CurPos() ); }
 
@@ -152,7 +162,10 @@ protected:
 
 public:
 
-    NCPad( int lines, int cols, const NCWidget & p );
+    /** Create a pad for \a lines x \a cols. A \a virtualPad is always
+     * pageing, no matter how many lines it holds.
+     */
+    NCPad( int lines, int cols, const NCWidget & p, bool virtualPad = false );
     virtual ~NCPad() {}
 
 public:
@@ -165,6 +178,14 @@ public:
     virtual void wRecoded();
     virtual void setDirty() { dirty = true; }
 
+    /** While \a hold is set, \ref update does not draw but just marks the
+     * pad dirty, so it is completely redrawn by the first update after
+     * releasing the hold. A pad may skip more work while held (e.g.
+     * NCTablePad::setpos measures no lines). Used to batch changes (see
+     * NCPadWidget::beginUpdate).
+     */
+    void holdUpdates( bool hold ) { held = hold; }
+
     int update();
     virtual int setpos() { return setpos( CurPos() ); }
 
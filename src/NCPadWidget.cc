@@ -261,7 +261,7 @@ NCPadWidget::NCPadWidget( NCWidget * myparent )
 	, padwin( 0 )
 	, hsb( 0 )
 	, vsb( 0 )
-	, multidraw( false )
+	, multidraw( 0 )
 	, pad( 0 )
 	, hasHeadline( false )
 	, activeLabelOnly( false )
@@ -277,7 +277,7 @@ NCPadWidget::NCPadWidget( YWidget * myparent )
 	, padwin( 0 )
 	, hsb( 0 )
 	, vsb( 0 )
-	, multidraw( false )
+	, multidraw( 0 )
 	, pad( 0 )
 	, hasHeadline( false )
 	, activeLabelOnly( false )
@@ -368,6 +368,7 @@ void NCPadWidget::InitPad()
 
     pad = CreatePad();
     pad->SendSchrollCB( this );
+    pad->holdUpdates( inMultidraw() );
     AdjustPad( wsze( pad->height(), pad->width() ) );
     DrawPad();
 }
@@ -477,11 +478,33 @@ NCPad * NCPadWidget::CreatePad()
 }
 
 
+void NCPadWidget::startMultidraw()
+{
+    if ( !multidraw++ && pad )
+	pad->holdUpdates( true );
+}
+
+
+void NCPadWidget::stopMultidraw()
+{
+    if ( !multidraw )
+	return;
+
+    if ( --multidraw )
+	return;
+
+    if ( pad )
+	pad->holdUpdates( false );
+
+    DrawPad();
+}
+
+
 void NCPadWidget::DrawPad()
 {
+    // Redraw() updates the pad via wRedraw(), if it is visible at all.
     if ( pad && !inMultidraw() )
     {
-	pad->update();
 	Redraw();
     }
 }
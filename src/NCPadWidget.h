@@ -50,7 +50,7 @@ private:
     NCScrollbar *   vsb;
 
     wsze  minPadSze;
-    bool  multidraw;
+    unsigned multidraw;
     NCPad * pad;
 
 protected:
@@ -64,9 +64,9 @@ protected:
     bool    hasHeadline;
     bool    activeLabelOnly;
 
-    void startMultidraw()    { multidraw = true; }
+    void startMultidraw();
 
-    void stopMultidraw()     { multidraw = false; DrawPad(); }
+    void stopMultidraw();
 
     bool inMultidraw() const { return multidraw; }
 
@@ -121,6 +121,34 @@ public:
     void setLabel( const NClabel & nlabel );
 
     virtual void setEnabled( bool do_bv ) { NCWidget::setEnabled( do_bv ); }
+
+    /**
+     * Batch changes: until the matching endUpdate() the pad is not
+     * redrawn, changes are just recorded. The outermost endUpdate()
+     * redraws the visible part of the pad once. Calls may be nested.
+     */
+    void beginUpdate() { startMultidraw(); }
+
+    void endUpdate()   { stopMultidraw(); }
+
+    /**
+     * Calls beginUpdate() on construction and endUpdate() on destruction.
+     */
+    class UpdateGuard
+    {
+    public:
+
+	UpdateGuard( NCPadWidget & w ) : widget( w ) { widget.beginUpdate(); }
+
+	~UpdateGuard() { widget.endUpdate(); }
+
+    private:
+
+	UpdateGuard & operator=( const UpdateGuard & );
+	UpdateGuard( const UpdateGuard & );
+
+	NCPadWidget & widget;
+    };
 };
 
 
@@ -28,7 +28,10 @@
 #include "YNCursesUI.h"
 #include "stringutil.h"
 #include "stdutil.h"
-#include <sstream>
+#include "NCwidth.h"
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
 #include <boost/algorithm/string.hpp>
 
 #include <yui/YMenuItem.h>
@@ -42,124 +45,184 @@ const std::wstring	NCRichText::listleveltags( L"@*+o#-%$&" );//
 
 const bool NCRichText::showLinkTarget = false;
 
-std::map<std::wstring, std::wstring> NCRichText::_charentity;
+const unsigned NCRichText::backgroundLayoutMin = 256 * 1024;
+const unsigned NCRichText::layoutSliceChars    = 64 * 1024;
+const unsigned NCRichText::layoutSliceOps      = 16 * 1024;
 
 
 
-const std::wstring NCRichText::entityLookup( const std::wstring & val_r )
+bool NCRichText::entityLookup( const wchar_t * name, size_t len, std::wstring & out )
 {
-    //strip leading '#', if any
-    std::wstring::size_type hash = val_r.find( L"#", 0 );
-    std::wstring ascii = L"";
-
-    if ( hash != std::wstring::npos )
+    if ( len > 1 && name[0] == L'#' )
     {
-	std::wstring s = val_r.substr( hash + 1 );
-	wchar_t *endptr;
-	//and try to convert to int (wcstol only knows "0x" for hex)
-        boost::replace_all( s, "x", "0x" );
-        
-	long int c = std::wcstol( s.c_str(), &endptr, 0 );
+	// numeric: "#42" or "#x2a"
+	unsigned long c = 0;
+	unsigned base = 10;
+	size_t i = 1;
+
+	if ( name[1] == L'x' || name[1] == L'X' )
+	{
+	    base = 16;
+	    ++i;
+	}
 
-	//conversion succeeded
+	if ( i == len )
+	    return false;
 
-	if ( s.c_str() != endptr )
+	for ( ; i < len; ++i )
 	{
-	    std::wostringstream ws;
-	    ws << char( c );
-	    ascii = ws.str();
+	    wchar_t ch = name[i];
+	    unsigned digit;
+
+	    if ( ch >= L'0' && ch <= L'9' )
+		digit = ch - L'0';
+	    else if ( base == 16 && ch >= L'a' && ch <= L'f' )
+		digit = ch - L'a' + 10;
+	    else if ( base == 16 && ch >= L'A' && ch <= L'F' )
+		digit = ch - L'A' + 10;
+	    else
+		return false;
+
+	    c = c * base + digit;
+
+	    if ( c > 0x10ffff )
+		return false;
 	}
-    }
 
-#define REP(l,r) _charentity[l] = r
-    if ( _charentity.empty() )
-    {
-	// initialize replacement for character entities. A value of NULL
-	// means do not replace.
-	std::wstring product;
-	NCstring::RecodeToWchar( YUI::app()->productName(), "UTF-8", &product );
-
-	REP( L"amp", L"&" );
-	REP( L"gt", L">" );
-	REP( L"lt", L"<" );
-	REP( L"nbsp", L" " );
-	REP( L"quot", L"\"" );
-	REP( L"product", product );
+	// no NUL, no surrogates
+	if ( c == 0 || ( c >= 0xd800 && c <= 0xdfff ) )
+	    return false;
+
+	out += ( wchar_t ) c;
+	return true;
     }
 
-    std::map<std::wstring, std::wstring>::const_iterator it = _charentity.find( val_r );
+    // The named entities, dispatched by length and first character.
+    // This is a perfect hash: no two of them share both.
+    const wchar_t * repl = 0;
 
-    if ( it != _charentity.end() )
+#define ENT(n,r) if ( std::wmemcmp( name, n, len ) == 0 ) repl = r
+    switch ( len )
     {
-	//known entity - already in the map
-	return it->second;
-    }
-    else
-    {
-	if ( !ascii.empty() )
-	{
-	    //replace ascii code by character - e.g. #42 -> '*'
-	    //and insert into map to remember it
-	    REP( val_r, ascii );
-	}
+	case 2:
+	    if ( name[0] == L'g' )	{ ENT( L"gt", L">" ); }
+	    else if ( name[0] == L'l' )	{ ENT( L"lt", L"<" ); }
+
+	    break;
+
+	case 3:
+	    ENT( L"amp", L"&" );
+	    break;
+
+	case 4:
+	    if ( name[0] == L'n' )	{ ENT( L"nbsp", L" " ); }
+	    else if ( name[0] == L'q' )	{ ENT( L"quot", L"\"" ); }
+
+	    break;
+
+	case 7:
+	    if ( std::wmemcmp( name, L"product", len ) == 0 )
+	    {
+		static std::wstring product;
+		static bool	    init = false;
+
+		if ( !init )
+		{
+		    NCstring::RecodeToWchar( YUI::app()->productName(), "UTF-8", &product );
+		    init = true;
+		}
+
+		out += product;	// even if empty
+		return true;
+	    }
+
+	    break;
     }
+#undef ENT
 
-    return ascii;
+    if ( !repl )
+	return false;
 
-#undef REP
+    out += repl;
+    return true;
 }
 
 
 
 /**
- * Filter out the known &...; entities and return the text with entities
- * replaced
+ * Filter out the known &...; entities in one pass, appending the text
+ * to out
  **/
-const std::wstring NCRichText::filterEntities( const std::wstring & text )
+void NCRichText::filterEntities( const wchar_t * sch, const wchar_t * ech, std::wstring & out )
 {
-    std::wstring txt = text;
-    // filter known '&..;'
-
-    for ( std::wstring::size_type special = txt.find( L"&" );
-	  special != std::wstring::npos;
-	  special = txt.find( L"&", special + 1 ) )
+    while ( sch < ech )
     {
-	std::wstring::size_type colon = txt.find( L";", special + 1 );
+	const wchar_t * amp = std::find( sch, ech, L'&' );
+	out.append( sch, amp );
 
-	if ( colon == std::wstring::npos )
-	    break;  // no ';'  -> no need to continue
+	if ( amp == ech )
+	    break;
+
+	// the name ends at ';', but not beyond the next '&'
+	const wchar_t * name = amp + 1;
+	const wchar_t * colon = name;
 
-	const std::wstring repl = entityLookup( txt.substr( special + 1, colon - special - 1 ) );
+	while ( colon < ech && *colon != L';' && *colon != L'&' )
+	    ++colon;
 
-	if ( !repl.empty()
-	     || txt.substr( special + 1, colon - special - 1 ) == L"product" )	// always replace &product;
+	if ( colon < ech && *colon == L';' && entityLookup( name, colon - name, out ) )
 	{
-	    txt.replace( special, colon - special + 1, repl );
+	    sch = colon + 1;
 	}
 	else
-	    yuiMilestone() << "porn.bat" << std::endl;
+	{
+	    out += L'&';	// not an entity: keep it
+	    sch = name;
+	}
     }
-
-    return txt;
 }
 
 
-void NCRichText::Anchor::draw( NCPad & pad, const chtype attr, int color )
+/**
+ * The pad of a NCRichText. It is virtual: the lines visible in the
+ * destination window are drawn by NCRichText::drawLine.
+ **/
+class NCRichTextPad : public NCPad
 {
-    unsigned l = sline;
-    unsigned c = scol;
+public:
+
+    NCRichTextPad( int lines, int cols, NCRichText & p )
+	: NCPad( lines, cols, p, true )
+	, richText( p )
+    {}
+
+protected:
 
-    while ( l < eline )
+    virtual void directDraw( NCursesWindow & w, const wrect at, unsigned lineno )
     {
-	pad.move( l, c );
-	pad.chgat( -1, attr, color );
-	++l;
-	c = 0;
+	richText.drawLine( w, at, lineno );
     }
 
-    pad.move( l, c );
+private:
 
-    pad.chgat( ecol - c, attr, color );
+    NCRichText & richText;
+};
+
+
+void NCRichText::Anchor::draw( NCursesWindow & w, int row, unsigned line,
+			       const chtype attr, int color )
+{
+    if ( line < sline || line > eline )
+	return;
+
+    unsigned c = ( line == sline ) ? scol : 0;
+
+    w.move( row, c );
+
+    if ( line < eline )
+	w.chgat( -1, attr, color );
+    else
+	w.chgat( ecol - c, attr, color );
 }
 
 
@@ -176,6 +239,13 @@ NCRichText::NCRichText( YWidget * parent, const std::string & ntext,
 	, atbol( true )
 	, preTag( false )
 	, Tattr( 0 )
+	, cattr( 0 )
+	, parsedTo( 0 )
+	, laidOut( 0 )
+	, valueSize( 0 )
+	, layoutJob( *this )
+	, backgroundLayout( true )
+	, layoutPending( false )
 {
     yuiDebug() << std::endl;
     activeLabelOnly = true;
@@ -223,13 +293,68 @@ void NCRichText::setLabel( const std::string & nlabel )
 
 void NCRichText::setValue( const std::string & ntext )
 {
+    stopLayout();
     DelPad();
     text = NCstring( ntext );
+    clearOps();
+    appendedValue.clear();
+    valueSize = ntext.size();
     YRichText::setValue( ntext );
     Redraw();
 }
 
 
+void NCRichText::appendValue( const std::string & ntext )
+{
+    text += NCstring( ntext );
+    appendedValue += ntext;
+
+    // copy the value when it doubled: O(1) per appended char
+    if ( appendedValue.size() >= valueSize )
+	syncValue();
+
+    if ( layoutPending )
+	return;	// the layout job continues with the new text
+
+    if ( plainText || !myPad() || !parsedTo )
+    {
+	// nothing laid out yet: done on the next redraw
+	DelPad();
+	Redraw();
+	return;
+    }
+
+    ParseHTML( ( unsigned ) - 1, true );
+    PadOps( laidOut, ops.size() );
+
+    if ( autoScrollDown() )
+	myPad()->ScrlLine( cl );	// the pad stops at its last line
+
+    NCPadWidget::DrawPad();
+}
+
+
+// Add the appended text to the YRichText value.
+void NCRichText::syncValue()
+{
+    if ( appendedValue.empty() )
+	return;
+
+    YRichText::setValue( YRichText::value() + appendedValue );
+    valueSize += appendedValue.size();
+    appendedValue.clear();
+}
+
+
+YPropertyValue NCRichText::getProperty( const std::string & propertyName )
+{
+    if ( propertyName == YUIProperty_Value )
+	syncValue();
+
+    return YRichText::getProperty( propertyName );
+}
+
+
 void NCRichText::wRedraw()
 {
     if ( !win )
@@ -244,7 +369,7 @@ void NCRichText::wRedraw()
 
     if ( initial && autoScrollDown() )
     {
-	myPad()->ScrlTo( wpos( myPad()->maxy(), 0 ) );
+	myPad()->ScrlLine( cl );	// the pad stops at its last line
     }
 
     return;
@@ -253,6 +378,7 @@ void NCRichText::wRedraw()
 
 void NCRichText::wRecoded()
 {
+    // the text is kept as wchar: just lay it out again
     DelPad();
     wRedraw();
 }
@@ -292,7 +418,7 @@ NCPad * NCRichText::CreatePad()
 {
     wsze psze( defPadSze() );
     textwidth = psze.W;
-    NCPad * npad = new NCPad( psze.H, textwidth, *this );
+    NCPad * npad = new NCRichTextPad( psze.H, textwidth, *this );
     return npad;
 }
 
@@ -304,8 +430,8 @@ void NCRichText::DrawPad()
     << "       padsize " << myPad()->size() << std::endl
     << "       text length " << text.str().size() << std::endl;
 
-    myPad()->bkgdset( wStyle().richtext.plain );
-    myPad()->clear();
+    stopLayout();
+    clearRuns();
 
     if ( plainText )
 	DrawPlainPad();
@@ -324,32 +450,147 @@ void NCRichText::DrawPlainPad()
     AdjustPad( wsze( ftext.Lines(), ftext.Columns() ) );
 
     cl = 0;
+    cattr = wStyle().richtext.plain;
 
     for ( NCtext::const_iterator line = ftext.begin();
 	  line != ftext.end(); ++line, ++cl )
     {
-	myPad()->addwstr( cl, 0, ( *line ).str().c_str() );
+	cc = 0;
+	addRun( ( *line ).str().data(), ( *line ).str().size() );
     }
 }
 
-void NCRichText::PadPreTXT( const wchar_t * osch, const unsigned olen )
+void NCRichText::PadPreTXT( const wchar_t * sch, const unsigned len )
 {
-    std::wstring wtxt( osch, olen );
+    // insert the text
+    addRun( sch, len );
+}
 
-    // resolve the entities even in PRE (#71718)
-    wtxt = filterEntities( wtxt );
 
-    NCstring nctxt( wtxt );
-    NCtext ftext( nctxt );
+void NCRichText::clearRuns()
+{
+    runs.clear();
+    lineRuns.clear();
+    runtext.clear();
+}
 
-    // insert the text
-    const wchar_t * sch = wtxt.data();
 
-    while ( *sch )
+//
+// Add the text at the current position [cl,cc] and move cc behind it.
+// Tabs are expanded, other non printable characters are left out.
+//
+void NCRichText::addRun( const wchar_t * sch, unsigned len )
+{
+    while ( lineRuns.size() <= cl )
+	lineRuns.push_back( runs.size() );
+
+    const wchar_t * ech = sch + len;
+
+    for ( ; sch < ech; ++sch )
     {
-	myPad()->addwstr( sch, 1 );	// add one wide chararacter
+	unsigned width;
+	unsigned chars = 1;
 
-	++sch;
+	if ( *sch == L'\t' )
+	{
+	    unsigned tabsize = myPad()->tabsize();
+	    width = chars = tabsize - cc % tabsize;
+	    runtext.append( chars, L' ' );
+	}
+	else
+	{
+	    int w = NCwidth::of( *sch );
+
+	    if ( w < 0 )
+		continue;
+
+	    width = w;
+	    runtext += *sch;
+	}
+
+	// The text of the last run ends where this one starts, as
+	// runtext is just appended to: continue it if possible.
+	if ( runs.size() > lineRuns[cl]
+	     && runs.back().attr == cattr
+	     && runs.back().col + runs.back().width == cc )
+	{
+	    runs.back().width += width;
+	    runs.back().len   += chars;
+	}
+	else
+	{
+	    Run run;
+	    run.col   = cc;
+	    run.width = width;
+	    run.attr  = cattr;
+	    run.start = runtext.size() - chars;
+	    run.len   = chars;
+	    runs.push_back( run );
+	}
+
+	cc += width;
+    }
+}
+
+
+//
+// Draw line of the text at at.Pos.L of w (see NCRichTextPad)
+//
+void NCRichText::drawLine( NCursesWindow & w, const wrect at, unsigned line )
+{
+    const NCstyle::StRichtext & style( wStyle().richtext );
+
+    w.bkgdset( style.plain );
+    w.move( at.Pos.L, at.Pos.C );
+    w.clrtoeol();
+
+    if ( line >= lineRuns.size() )
+	return;
+
+    unsigned first = lineRuns[line];
+    unsigned last  = ( line + 1 < lineRuns.size() ) ? lineRuns[line + 1] : runs.size();
+    unsigned width = at.Sze.W;
+
+    for ( unsigned i = first; i < last; ++i )
+    {
+	const Run & run( runs[i] );
+
+	if ( run.col >= width )
+	    continue;
+
+	const wchar_t * sch = runtext.data() + run.start;
+	unsigned len = run.len;
+
+	if ( run.col + run.width > width )
+	{
+	    // clip a <pre> line wider than the pad
+	    unsigned cols = run.col;
+
+	    for ( len = 0; len < run.len; ++len )
+	    {
+		int cw = std::max( 0, NCwidth::of( sch[len] ) );
+
+		if ( cols + cw > width )
+		    break;
+
+		cols += cw;
+	    }
+	}
+
+	w.bkgdset( run.attr );
+	w.addwstr( at.Pos.L, at.Pos.C + run.col, sch, len );
+    }
+
+    if ( plainText || anchors.empty() )
+	return;
+
+    for ( unsigned i = firstAnchorEnding( line );
+	  i < anchors.size() && anchors[i].sline <= line; ++i )
+    {
+	if ( i == armed )
+	    anchors[i].draw( w, at.Pos.L, line, style.getArmed( GetState() ), 0 );
+	else if ( anchors[i].visited )
+	    anchors[i].draw( w, at.Pos.L, line, style.link, ( int ) style.visitedlink );
     }
 }
 
@@ -410,9 +651,8 @@ inline void SkipPreTXT( const wchar_t *& wch )
 
 //
 // Calculate longest line of text in <pre> </pre> tags
-// and adjust the pad accordingly
 //
-void NCRichText::AdjustPrePad( const wchar_t *osch )
+void NCRichText::MeasurePre( const wchar_t *osch, unsigned & width )
 {
     const wchar_t * wch = osch;
     std::wstring wstr( wch, 6 );
@@ -424,62 +664,134 @@ void NCRichText::AdjustPrePad( const wchar_t *osch )
     }
     while ( *wch && wstr != L"</pre>" );
 
-    std::wstring wtxt( osch, wch - osch );
+    std::wstring wtxt;
 
     // resolve the entities to get correct length for calculation of longest line
-    wtxt = filterEntities( wtxt );
+    filterEntities( osch, wch, wtxt );
 
-    // replace <br> by \n to get appropriate lines in NCtext
+    // replace <br> by \n to get the lines
     boost::replace_all( wtxt, L"<br>", L"\n" );
     boost::replace_all( wtxt, L"<br/>", L"\n" );
 
     yuiDebug() << "Text: " << wtxt << " initial length: " << wch - osch << std::endl;
 
-    NCstring nctxt( wtxt );
-    NCtext ftext( nctxt );
-
-    std::list<NCstring>::const_iterator line;
     size_t llen = 0;		// longest line
-    
-    // iterate through NCtext
-    for ( line = ftext.Text().begin(); line != ftext.Text().end(); ++line )
+
+    for ( size_t bol = 0; bol <= wtxt.size(); )
     {
-	size_t tmp_len = 0;
+	size_t eol = wtxt.find( L'\n', bol );
+
+	if ( eol == std::wstring::npos )
+	    eol = wtxt.size();
 
-        tmp_len = textWidth( (*line).str() );
+	size_t tmp_len = textWidth( wtxt.data() + bol, eol - bol );
 
 	if ( tmp_len > llen )
 	    llen = tmp_len;
+
+	bol = eol + 1;
     }
     yuiDebug() << "Longest line: " << llen << std::endl;
-    
-    if ( llen > textwidth )
+
+    width = llen;
+}
+
+
+//
+// Adjust the pad to the longest line of text in <pre> </pre> tags
+//
+void NCRichText::AdjustPrePad( unsigned width )
+{
+    if ( width > textwidth )
     {
-	textwidth = llen;
-	AdjustPad( wsze( cl + ftext.Lines(), llen ) );	// adjust pad to longest line
+	textwidth = width;	// the pad is adjusted to the longest line by PadOps
     }
+}
+
 
+// Entities are resolved on the fly: the text is appended to optext
+// without a copy.
+void NCRichText::addTextOp( OpKind kind, const wchar_t * sch, const wchar_t * ech )
+{
+    Op op( kind );
+    op.start = optext.size();
+    filterEntities( sch, ech, optext );
+    op.len   = optext.size() - op.start;
+    ops.push_back( op );
 }
 
-void NCRichText::DrawHTMLPad()
+
+void NCRichText::clearOps()
 {
-    yuiDebug() << "Start:" << std::endl;
+    ops.clear();
+    optext.clear();
+    parsedTo = 0;
+    laidOut = 0;
+    preTag = false;
+}
 
-    liststack = std::stack<int>();
-    canchor = Anchor();
-    anchors.clear();
-    armed = Anchor::unset;
 
-    cl = 0;
-    cc = 0;
-    cindent = 0;
-    myPad()->move( cl, cc );
-    atbol = true;
+// Whether the '<' at lt starts a tag (which may be cut at end).
+inline bool tagStart( const wchar_t * lt, const wchar_t * end )
+{
+    return *lt == L'<'
+	   && ( lt + 1 == end || std::iswalpha( lt[1] ) || lt[1] == L'/' || lt[1] == L'!' );
+}
+
+
+//
+// Split the text into words, white space and tags. The entities are
+// resolved and the tags are looked up here, so laying out the text
+// again (for another width) needs no parsing. Parses the text not
+// parsed yet, i.e. just the appended text (see appendValue), but
+// stops after about limit characters. Returns whether text is left.
+// With holdBack, the text may continue (see appendValue): a tag, word,
+// entity or white space at the end is left for the next call.
+//
+bool NCRichText::ParseHTML( unsigned limit, bool holdBack )
+{
+    yuiDebug() << "Start: " << parsedTo << std::endl;
 
-    const wchar_t * wch = ( wchar_t * )text.str().data();
+    const std::wstring & wtext( text.str() );
+    const wchar_t * wch = wtext.data() + parsedTo;
+    const wchar_t * end = wtext.data() + wtext.size();
     const wchar_t * swch = 0;
+    const wchar_t * stop = ( ( unsigned )( end - wch ) > limit ) ? wch + limit : end;
 
-    while ( *wch )
+    if ( holdBack )
+    {
+	// Stop after the last '>', or at the white space before the last
+	// word. A '<' not followed by a tag name (e.g. "a < b") is text.
+	const wchar_t * lt = end;
+
+	while ( lt > wch && lt[-1] != L'>' && !tagStart( lt - 1, end ) && WStoken.find( lt[-1] ) == std::wstring::npos )
+	    --lt;
+
+	if ( lt > wch && tagStart( lt - 1, end ) )
+	    --lt;
+	else
+	{
+	    while ( lt > wch && WStoken.find( lt[-1] ) != std::wstring::npos )
+		--lt;
+
+	    // inside a tag, stop at its '<'
+	    for ( const wchar_t * t = lt; t > wch; )
+	    {
+		if ( *--t == L'>' )
+		    break;
+
+		if ( tagStart( t, end ) )
+		{
+		    lt = t;
+		    break;
+		}
+	    }
+	}
+
+	end = lt;
+    }
+
+    while ( wch < end && wch < stop )
     {
 	switch ( *wch )
 	{
@@ -492,7 +804,7 @@ void NCRichText::DrawHTMLPad()
 		if ( ! preTag )
 		{
 		    SkipWS( wch );
-		    PadWS();
+		    ops.push_back( Op( O_WS ) );
 		}
 		else
 		{
@@ -500,12 +812,12 @@ void NCRichText::DrawHTMLPad()
 		    {
 			case L' ':	// add white space
 			case L'\t':
-			    myPad()->addwstr( wch, 1 );
+			    addTextOp( O_PRETEXT, wch, wch + 1 );
 			    break;
 
 			case L'\n':
                         case L'\f':
-			    PadNL();	// add new line
+			    ops.push_back( Op( O_NL ) );	// add new line
 			    break;
 
 			default:
@@ -520,7 +832,7 @@ void NCRichText::DrawHTMLPad()
 		swch = wch;
 		SkipToken( wch );
 
-		if ( PadTOKEN( swch, wch ) )
+		if ( ParseTOKEN( swch, wch ) )
 		    break;	// strip token
 		else
 		    wch = swch;		// reset and fall through
@@ -531,20 +843,64 @@ void NCRichText::DrawHTMLPad()
 		if ( !preTag )
 		{
 		    SkipWord( wch );
-		    PadTXT( swch, wch - swch );
+		    addTextOp( O_TEXT, swch, wch );
 		}
 		else
 		{
 		    SkipPreTXT( wch );
-		    PadPreTXT( swch, wch - swch );
+		    // resolve the entities even in PRE (#71718)
+		    addTextOp( O_PRETEXT, swch, wch );
 		}
 
 		break;
 	}
     }
 
-    PadBOL();
-    AdjustPad( wsze( cl, textwidth ) );
+    parsedTo = wch - wtext.data();
+
+    yuiDebug() << "Ops: " << ops.size() << std::endl;
+
+    return wch < end;
+}
+
+
+void NCRichText::DrawHTMLPad()
+{
+    yuiDebug() << "Start:" << std::endl;
+
+    liststack = std::stack<int>();
+    canchor = Anchor();
+    anchors.clear();
+    armed = Anchor::unset;
+
+    cl = 0;
+    cc = 0;
+    cindent = 0;
+    Tattr = 0;
+    atbol = true;
+    laidOut = 0;
+
+    if ( backgroundLayout && text.str().size() > backgroundLayoutMin )
+    {
+	// lay out the first screen now, the rest while idle
+	unsigned screen = defPadSze().H;
+	bool more = true;
+
+	while ( more && cl <= screen )
+	    more = layoutStep();
+
+	if ( more )
+	{
+	    layoutPending = true;
+	    NCurses::AddIdleHandler( &layoutJob );
+	    return;
+	}
+    }
+    else
+    {
+	ParseHTML();
+	PadOps( 0, ops.size() );
+    }
 
     yuiDebug() << "Anchors: " << anchors.size() << std::endl;
 
@@ -558,17 +914,75 @@ void NCRichText::DrawHTMLPad()
 }
 
 
-inline void NCRichText::PadNL()
+//
+// Lay out the ops from first to last, continuing at the current position
+//
+void NCRichText::PadOps( unsigned first, unsigned last )
 {
-    cc = cindent;
+    PadSetAttr();
+
+    for ( unsigned i = first; i < last; ++i )
+	PadOp( ops[i] );
+
+    laidOut = last;
+
+    // leave the last line open for appended text
+    AdjustPad( wsze( atbol ? cl : cl + 1, textwidth ) );
+}
+
+
+//
+// Parse and lay out the next slice of the text. Returns whether text
+// is left.
+//
+bool NCRichText::layoutStep()
+{
+    bool more = ( parsedTo < text.str().size() );
+
+    if ( laidOut == ops.size() )
+	more = ParseHTML( layoutSliceChars );
+
+    PadOps( laidOut, std::min( laidOut + layoutSliceOps, ( unsigned )ops.size() ) );
+
+    return more || laidOut < ops.size();
+}
+
 
-    if ( ++cl == ( unsigned )myPad()->height() )
+// A slice of the background layout (called via LayoutJob::idle)
+bool NCRichText::layoutIdle()
+{
+    if ( !myPad() )
     {
-	AdjustPad( wsze( myPad()->height() + defPadSze().H, textwidth ) );
+	// laid out again when the pad is created
+	layoutPending = false;
+	return false;
     }
 
-    myPad()->move( cl, cc );
+    layoutPending = layoutStep();
+
+    if ( !layoutPending )
+	yuiDebug() << "Done: lines " << cl << ", anchors " << anchors.size() << std::endl;
+
+    if ( autoScrollDown() )
+	myPad()->ScrlLine( cl );
+
+    NCPadWidget::DrawPad();
 
+    return layoutPending;
+}
+
+
+void NCRichText::stopLayout()
+{
+    NCurses::RemoveIdleHandler( &layoutJob );
+    layoutPending = false;
+}
+
+
+inline void NCRichText::PadNL()
+{
+    cc = cindent;
+    ++cl;	// the pad is adjusted to the lines by PadOps
     atbol = true;
 }
 
@@ -591,30 +1005,25 @@ inline void NCRichText::PadWS( const bool tab )
     }
     else
     {
-	myPad()->addwstr( L" " );
-	++cc;
+	addRun( L" ", 1 );
     }
 }
 
 
 inline void NCRichText::PadTXT( const wchar_t * osch, const unsigned olen )
 {
-    std::wstring txt( osch, olen );
-
-    txt = filterEntities( txt );
-
-    size_t	len = textWidth( txt );
+    size_t	len = textWidth( osch, olen );
 
     if ( !atbol && cc + len > textwidth )
 	PadNL();
 
     // insert the text
-    const wchar_t * sch = txt.data();
+    const wchar_t * sch = osch;
+    const wchar_t * ech = osch + olen;
 
-    while ( *sch )
+    while ( sch < ech )
     {
-	myPad()->addwstr( sch, 1 );	// add one wide chararacter
-	cc += wcwidth( *sch );
+	addRun( sch, 1 );	// add one wide chararacter
 	atbol = false;	// at begin of line = false
 
 	if ( cc >= textwidth )
@@ -633,25 +1042,9 @@ inline void NCRichText::PadTXT( const wchar_t * osch, const unsigned olen )
  * Attention: only use textWidth() to calculate space, not for iterating through a text
  * or to get the length of a text (real text length includes new lines).
  */
-size_t NCRichText::textWidth( std::wstring wstr )
+size_t NCRichText::textWidth( const wchar_t * wstr, size_t wlen )
 {
-    size_t len = 0;
-    std::wstring::const_iterator wstr_it;	// iterator for std::wstring
-
-    for ( wstr_it = wstr.begin(); wstr_it != wstr.end() ; ++wstr_it )
-    {
-	// check whether char is printable
-	if ( iswprint( *wstr_it ) )
-	{
-	    len += wcwidth( *wstr_it );
-	}
-	else if ( *wstr_it == '\t' )
-	{
-	    len += myPad()->tabsize();
-	}
-    }
-
-    return len;
+    return NCwidth::columns( wstr, wlen, myPad()->tabsize() );
 }
 
 
@@ -705,7 +1098,7 @@ inline void NCRichText::PadSetAttr()
 	}
     }
 
-    myPad()->bkgdset( nbg );
+    cattr = nbg;
 }
 
 
@@ -717,10 +1110,7 @@ void NCRichText::PadSetLevel()
 	cindent = textwidth / 2;
 
     if ( atbol )
-    {
 	cc = cindent;
-	myPad()->move( cl, cc );
-    }
 }
 
 
@@ -740,15 +1130,22 @@ void NCRichText::PadChangeLevel( bool down, int tag )
 }
 
 
-void NCRichText::openAnchor( std::wstring args )
+void NCRichText::openAnchor( const std::wstring & target )
 {
     canchor.open( cl, cc );
+    canchor.target = target;
+}
+
 
-    const wchar_t * ch = ( wchar_t * )args.data();
+// Append the value of 'href' in the arguments [sch, ech) of an anchor tag
+// to out
+void NCRichText::anchorTarget( const wchar_t * sch, const wchar_t * ech, std::wstring & out )
+{
+    const wchar_t * ch = sch;
     const wchar_t * lookupstr = L"href = ";
     const wchar_t * lookup = lookupstr;
 
-    for ( ; *ch && *lookup; ++ch )
+    for ( ; ch != ech && *lookup; ++ch )
     {
 	wchar_t c = towlower( *ch );
 
@@ -786,20 +1183,36 @@ void NCRichText::openAnchor( std::wstring args )
 
     if ( !*lookup )
     {
-	const wchar_t * delim = ( *ch == L'"' ) ? L"\"" : L" \t";
-	args = ( *ch == L'"' ) ? ++ch : ch;
+	bool quoted = ( ch != ech && *ch == L'"' );
 
-	std::wstring::size_type end = args.find_first_of( delim );
+	if ( quoted )
+	    ++ch;
 
-	if ( end != std::wstring::npos )
-	    args.erase( end );
+	const wchar_t * end = ch;
 
-	canchor.target = args;
-    }
-    else
-    {
-	yuiError() << "No value for 'HREF=' in anchor '" << args << "'" << std::endl;
+	while ( end != ech
+		&& ( quoted ? *end != L'"' : ( *end != L' ' && *end != L'\t' ) ) )
+	    ++end;
+
+	out.append( ch, end - ch );
+	return;
     }
+
+    yuiError() << "No value for 'HREF=' in anchor '" << std::wstring( sch, ech ) << "'" << std::endl;
+}
+
+
+unsigned NCRichText::firstAnchorEnding( unsigned line ) const
+{
+    return std::lower_bound( anchors.begin(), anchors.end(), line, Anchor::endsBefore )
+	   - anchors.begin();
+}
+
+
+unsigned NCRichText::firstAnchorStarting( unsigned line ) const
+{
+    return std::lower_bound( anchors.begin(), anchors.end(), line, Anchor::startsBefore )
+	   - anchors.begin();
 }
 
 
@@ -814,122 +1227,154 @@ void NCRichText::closeAnchor()
 }
 
 
-// expect "<[/]value>"
-bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
+void NCRichText::PadOp( const Op & op )
 {
-    // "<[/]value>"
-    if ( *sch++ != L'<' || *( ech - 1 ) != L'>' )
-	return false;
-
-    // "[/]value>"
-    bool endtag = ( *sch == L'/' );
+    switch ( op.kind )
+    {
+	case O_TEXT:
+	    PadTXT( optext.data() + op.start, op.len );
+	    break;
 
-    if ( endtag )
-	++sch;
+	case O_PRETEXT:
+	    PadPreTXT( optext.data() + op.start, op.len );
+	    break;
 
-    // "value>"
-    if ( ech - sch <= 1 )
-	return false;
+	case O_WS:
+	    PadWS();
+	    break;
 
-    std::wstring value( sch, ech - 1 - sch );
+	case O_NL:
+	    PadNL();
+	    break;
 
-    std::wstring args;
+	case O_TOKEN:
+	    PadTOKEN( op );
+	    break;
+    }
+}
 
-    std::wstring::size_type argstart = value.find_first_of( L" \t\n" );
 
-    if ( argstart != std::wstring::npos )
+// Whether the tag name [sch, sch+len) is name (ignoring case)
+static inline bool tagIs( const wchar_t * sch, size_t len, const char * name )
+{
+    for ( size_t i = 0; i < len; ++i )
     {
-	args = value.substr( argstart );
-	value.erase( argstart );
-    }
+	wchar_t c = sch[i];
 
-    for ( unsigned i = 0; i < value.length(); ++i )
-    {
-	if ( isupper( value[i] ) )
-	{
-	    value[i] = static_cast<char>( tolower( value[i] ) );
-	}
+	if ( c >= L'A' && c <= L'Z' )
+	    c += L'a' - L'A';
+
+	if ( c != ( wchar_t )name[i] )
+	    return false;
     }
 
-    int leveltag = 0;
+    return name[len] == '\0';
+}
 
-    int headinglevel = 0;
 
-    TOKEN token = T_UNKNOWN;
+// The hash of a tag name of length len, given its first and last
+// (lowercase) char. It is collision free for the tags known to
+// lookupTag, which the case labels there check at compile time.
+#define TAGHASH( first, last, len )	( ( (unsigned)(first) + (unsigned)(last) + 23 * (unsigned)(len) ) & 127 )
 
-    switch ( value.length() )
-    {
-	case 1:
 
-	    if      ( value[0] == 'b' )		token = T_BOLD;
-	    else if ( value[0] == 'i' )		token = T_IT;
-	    else if ( value[0] == 'p' )		token = T_PAR;
-	    else if ( value[0] == 'a' )		token = T_ANC;
-	    else if ( value[0] == 'u' )		token = T_BOLD;
+bool NCRichText::lookupTag( const wchar_t * sch, size_t len, TOKEN & token, int & level )
+{
+    if ( len == 0 || len > 10 )
+	return false;
 
-	    break;
+    wchar_t first = sch[0];
+    wchar_t last  = sch[len - 1];
 
-	case 2:
-	    if      ( value == L"br" )		token = T_BR;
-	    else if ( value == L"em" )		token = T_IT;
-	    else if ( value == L"h1" )		{ token = T_HEAD; headinglevel = 1; }
-	    else if ( value == L"h2" )		{ token = T_HEAD; headinglevel = 2; }
-	    else if ( value == L"h3" )		{ token = T_HEAD; headinglevel = 3; }
-	    else if ( value == L"hr" )		token = T_IGNORE;
-	    else if ( value == L"li" )		token = T_LI;
-	    else if ( value == L"ol" )		{ token = T_LEVEL; leveltag = 1; }
-	    else if ( value == L"qt" )		token = T_IGNORE;
-	    else if ( value == L"tt" )		token = T_TT;
-	    else if ( value == L"ul" )		{ token = T_LEVEL; leveltag = 0; }
+    if ( first >= L'A' && first <= L'Z' )
+	first += L'a' - L'A';
 
-	    break;
+    if ( last >= L'A' && last <= L'Z' )
+	last += L'a' - L'A';
 
-	case 3:
+    const char * name = 0;
 
-	    if      ( value == L"big" )		token = T_IGNORE;
-	    else if ( value == L"pre" )		token = T_PLAIN;
-            // <br> and <hr> are the only non-pair tags currently supported.
-            // We treat bellow these two special cases in order to work as
-            // users expect. This issue was described at 
-            // https://github.com/libyui/libyui-ncurses/issues/33
-            else if ( value == L"br/" )		token = T_BR;
-	    else if ( value == L"hr/" )		token = T_IGNORE;
+    level = 0;
 
-	    break;
+    switch ( TAGHASH( first, last, len ) )
+    {
+#define TAG( NAME, F, L, TOK, LEVEL ) \
+	case TAGHASH( F, L, sizeof( NAME ) - 1 ): name = NAME; token = TOK; level = LEVEL; break
+
+	TAG( "a",	'a', 'a', T_ANC,    0 );
+	TAG( "b",	'b', 'b', T_BOLD,   0 );
+	TAG( "i",	'i', 'i', T_IT,	    0 );
+	TAG( "p",	'p', 'p', T_PAR,    0 );
+	TAG( "u",	'u', 'u', T_BOLD,   0 );
+	TAG( "br",	'b', 'r', T_BR,	    0 );
+	TAG( "em",	'e', 'm', T_IT,	    0 );
+	TAG( "h1",	'h', '1', T_HEAD,   1 );
+	TAG( "h2",	'h', '2', T_HEAD,   2 );
+	TAG( "h3",	'h', '3', T_HEAD,   3 );
+	TAG( "hr",	'h', 'r', T_IGNORE, 0 );
+	TAG( "li",	'l', 'i', T_LI,	    0 );
+	TAG( "ol",	'o', 'l', T_LEVEL,  1 );
+	TAG( "qt",	'q', 't', T_IGNORE, 0 );
+	TAG( "tt",	't', 't', T_TT,	    0 );
+	TAG( "ul",	'u', 'l', T_LEVEL,  0 );
+	TAG( "big",	'b', 'g', T_IGNORE, 0 );
+	TAG( "pre",	'p', 'e', T_PLAIN,  0 );
+	// <br> and <hr> are the only non-pair tags currently supported.
+	// We treat bellow these two special cases in order to work as
+	// users expect. This issue was described at
+	// https://github.com/libyui/libyui-ncurses/issues/33
+	TAG( "br/",	'b', '/', T_BR,	    0 );
+	TAG( "hr/",	'h', '/', T_IGNORE, 0 );
+	TAG( "bold",	'b', 'd', T_BOLD,   0 );
+	TAG( "code",	'c', 'e', T_TT,	    0 );
+	TAG( "font",	'f', 't', T_IGNORE, 0 );
+	TAG( "large",	'l', 'e', T_IGNORE, 0 );
+	TAG( "small",	's', 'l', T_IGNORE, 0 );
+	TAG( "center",	'c', 'r', T_PAR,    0 );
+	TAG( "strong",	's', 'g', T_BOLD,   0 );
+	TAG( "blockquote", 'b', 'e', T_PAR, 0 );
+
+#undef TAG
 
-	case 4:
-	    if      ( value == L"bold" )	token = T_BOLD;
-	    else if ( value == L"code" )	token = T_TT;
-	    else if ( value == L"font" )	token = T_IGNORE;
+	default:
+	    return false;
+    }
 
-	    break;
+    return tagIs( sch, len, name );
+}
 
-	case 5:
-	    if      ( value == L"large" )	token = T_IGNORE;
-	    else if ( value == L"small" )	token = T_IGNORE;
 
-	    break;
+// expect "<[/]value>"
+bool NCRichText::ParseTOKEN( const wchar_t * sch, const wchar_t *& ech )
+{
+    // "<[/]value>"
+    if ( *sch++ != L'<' || *( ech - 1 ) != L'>' )
+	return false;
 
-	case 6:
-	    if      ( value == L"center" )	token = T_PAR;
-	    else if ( value == L"strong" )	token = T_BOLD;
+    // "[/]value>"
+    bool endtag = ( *sch == L'/' );
 
-	    break;
+    if ( endtag )
+	++sch;
 
-	case 10:
-	    if ( value == L"blockquote" )	token = T_PAR;
+    // "value>"
+    if ( ech - sch <= 1 )
+	return false;
 
-	    break;
+    // "value args>": args are [vend, ech - 1)
+    const wchar_t * vend = sch;
 
-	default:
-	    token = T_UNKNOWN;
+    while ( vend != ech - 1 && *vend != L' ' && *vend != L'\t' && *vend != L'\n' )
+	++vend;
 
-	    break;
-    }
+    TOKEN token = T_UNKNOWN;
 
-    if ( token == T_UNKNOWN )
+    int level = 0;
+
+    if ( !lookupTag( sch, vend - sch, token, level ) )
     {
-	yuiDebug() << "T_UNKNOWN :" << value << ":" << args << ":" << std::endl;
+	yuiDebug() << "T_UNKNOWN :" << std::wstring( sch, vend )
+		   << ":" << std::wstring( vend, ech - 1 ) << ":" << std::endl;
 	// see bug #67319
         //  return false;
 	return true;
@@ -938,6 +1383,56 @@ bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
     if ( token == T_IGNORE )
 	return true;
 
+    Op op( O_TOKEN );
+    op.token  = token;
+    op.endtag = endtag;
+
+    switch ( token )
+    {
+	case T_LEVEL:
+	case T_HEAD:
+	    op.level = level;
+	    break;
+
+	case T_PLAIN:
+	    preTag = !endtag;	// display text preserving newlines and spaces
+
+	    if ( !endtag )
+	    {
+		unsigned width = 0;
+		MeasurePre( ech, width );
+		op.level = width;
+	    }
+
+	    break;
+
+	case T_ANC:
+	    if ( !endtag )
+	    {
+		op.start = optext.size();
+		anchorTarget( vend, ech - 1, optext );
+		op.len	 = optext.size() - op.start;
+	    }
+
+	    break;
+
+	default:
+	    break;
+    }
+
+    ops.push_back( op );
+
+    return true;
+}
+
+
+void NCRichText::PadTOKEN( const Op & op )
+{
+    const TOKEN token	    = op.token;
+    const bool	endtag	    = op.endtag;
+    const int	leveltag    = op.level;
+    const int	headinglevel = op.level;
+
     switch ( token )
     {
 	case T_LEVEL:
@@ -1012,8 +1507,6 @@ bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
 		// outsent list tag:
 		cc = ( tag.size() < cc ? cc - tag.size() : 0 );
 
-		myPad()->move( cl, cc );
-
 		PadTXT( tag.c_str(), tag.size() );
 
 		atbol = true;
@@ -1025,12 +1518,10 @@ bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
 
 	    if ( !endtag )
 	    {
-		preTag = true;	// display text preserving newlines and spaces
-		AdjustPrePad( ech );
+		AdjustPrePad( op.level );
 	    }
 	    else
 	    {
-		preTag = false;
 		PadNL();	 // add new line (text may continue after </pre>)
 	    }
 
@@ -1044,7 +1535,7 @@ bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
 	    }
 	    else
 	    {
-		openAnchor( args );
+		openAnchor( optext.substr( op.start, op.len ) );
 	    }
 
 	    // fall through
@@ -1065,8 +1556,6 @@ bool NCRichText::PadTOKEN( const wchar_t * sch, const wchar_t *& ech )
 	case T_UNKNOWN:
 	    break;
     }
-
-    return true;
 }
 
 
@@ -1083,26 +1572,16 @@ void NCRichText::arm( unsigned i )
     if ( i == armed )
     {
 	if ( armed != Anchor::unset )
-	{
-	    // just redraw
-	    anchors[armed].draw( *myPad(), wStyle().richtext.getArmed( GetState() ), 0 );
-	    myPad()->update();
-	}
+	    myPad()->update();	// just redraw
 
 	return;
     }
 
+    // the anchors are highlighted when their lines are drawn
     if ( armed != Anchor::unset )
-    {
-	anchors[armed].draw( *myPad(), wStyle().richtext.link, ( int ) wStyle().richtext.visitedlink );
-	armed = Anchor::unset;
-    }
+	anchors[armed].visited = true;
 
-    if ( i != Anchor::unset )
-    {
-	armed = i;
-	anchors[armed].draw( *myPad(), wStyle().richtext.getArmed( GetState() ), 0 );
-    }
+    armed = i;
 
     if ( showLinkTarget )
     {
@@ -1146,14 +1625,11 @@ void NCRichText::VScroll( unsigned total, unsigned visible, unsigned start )
 	    disarm();
     }
 
-    for ( unsigned i = 0; i < anchors.size(); ++i )
-    {
-	if ( anchors[i].within( vScrollFirstvisible, vScrollNextinvisible ) )
-	{
-	    arm( i );
-	    break;
-	}
-    }
+    unsigned first = firstAnchorEnding( vScrollFirstvisible );
+
+    if ( first < anchors.size()
+	 && anchors[first].within( vScrollFirstvisible, vScrollNextinvisible ) )
+	arm( first );
 }
 
 
@@ -1177,16 +1653,10 @@ bool NCRichText::handleInput( wint_t key )
 		if ( armed == Anchor::unset )
 		{
 		    // look for an anchor above current page
-		    for ( unsigned i = anchors.size(); i; )
-		    {
-			--i;
+		    unsigned i = firstAnchorEnding( vScrollFirstvisible );
 
-			if ( anchors[i].eline < vScrollFirstvisible )
-			{
-			    newarmed = i;
-			    break;
-			}
-		    }
+		    if ( i > 0 )
+			newarmed = i - 1;
 		}
 		else if ( armed > 0 )
 		{
@@ -1216,14 +1686,10 @@ bool NCRichText::handleInput( wint_t key )
 		if ( armed == Anchor::unset )
 		{
 		    // look for an anchor below current page
-		    for ( unsigned i = 0; i < anchors.size(); ++i )
-		    {
-			if ( anchors[i].sline >= vScrollNextinvisible )
-			{
-			    newarmed = i;
-			    break;
-			}
-		    }
+		    unsigned i = firstAnchorStarting( vScrollNextinvisible );
+
+		    if ( i < anchors.size() )
+			newarmed = i;
 		}
 		else if ( armed + 1 < anchors.size() )
 		{
@@ -27,10 +27,12 @@
 
 #include <iosfwd>
 #include <stack>
+#include <vector>
 
 #include <yui/YRichText.h>
 #include "NCPadWidget.h"
 
+class NCRichTextPad;
 
 class NCRichText : public YRichText, public NCPadWidget
 {
@@ -38,27 +40,23 @@ private:
 
     friend std::ostream & operator<<( std::ostream & STREAM, const NCRichText & OBJ );
 
+    friend class NCRichTextPad;
+
     NCRichText & operator=( const NCRichText & );
     NCRichText( const NCRichText & );
 
     /**
-     * Lookup std::map for character entities (e.g. '&gt;'). Initialized
-     * and used by entityLookup.
+     * Append the replacement for the character entity \a name (without
+     * the leading <code>'&'</code> and trailing <code>';'</code>) to
+     * \a out. Returns \c false, if the entity is unknown.
      **/
-    static std::map<std::wstring, std::wstring> _charentity;
+    static bool entityLookup( const wchar_t * name, size_t len, std::wstring & out );
 
     /**
-     * Lookup and return replacement for a character entity. Expects
-     * the leading <code>'&'</code> and trailing <code>';'<.code> to
-     * be stripped from <code>val_r</code>. Returns <code>NULL</code>,
-     * if the character entity should not be replaced.
+     * Append the text from \a sch to \a ech to \a out, replacing the
+     * known character entities.
      **/
-    static const std::wstring entityLookup( const std::wstring & val_r );
-
-    /**
-     * Lookup and replace all replacements for a character entity.
-     **/
-    static const std::wstring filterEntities( const std::wstring & text );
+    static void filterEntities( const wchar_t * sch, const wchar_t * ech, std::wstring & out );
 
 private:
 
@@ -72,9 +70,10 @@ private:
     unsigned cindent;
     bool     atbol;
 
-    bool     preTag;		// <pre> tag
+    bool     preTag;		// <pre> tag (while parsing)
 
     unsigned Tattr;
+    chtype   cattr;		// attribute of the text added (see PadSetAttr)
 
     static const unsigned Tfontmask = 0xff00;
     enum TOKEN
@@ -94,6 +93,58 @@ private:
 	T_HEAD	  = 0x1000
     };
 
+private:
+
+    /**
+     * The HTML text is parsed once into a list of layout steps (see
+     * ParseHTML). DrawHTMLPad just lays them out for the current
+     * textwidth, e.g. after a resize or a change of the style.
+     **/
+    enum OpKind
+    {
+	O_TEXT,		// a word
+	O_PRETEXT,	// text inside <pre>
+	O_WS,		// white space between words
+	O_NL,		// a line break inside <pre>
+	O_TOKEN		// a tag
+    };
+
+    struct Op
+    {
+	OpKind	 kind;
+	TOKEN	 token;		// O_TOKEN
+	bool	 endtag;
+	int	 level;		// ordered list, heading level or longest line in <pre>
+	unsigned start;		// text (or anchor target) in optext
+	unsigned len;		// length of text
+
+	Op( OpKind k )
+	    : kind( k ), token( T_UNKNOWN ), endtag( false ), level( 0 ), start( 0 ), len( 0 )
+	{}
+    };
+
+    std::vector<Op> ops;
+    std::wstring    optext;	// the text of all ops, entities resolved
+    unsigned	    parsedTo;	// the characters of text parsed into ops
+    unsigned	    laidOut;	// the ops laid out
+
+    /** Text appended to the YRichText value lazily (see appendValue). */
+    std::string	    appendedValue;
+    std::string::size_type valueSize;	// of the YRichText value
+
+    void clearOps();
+    bool ParseHTML( unsigned limit = ( unsigned ) - 1, bool holdBack = false );
+    void syncValue();
+    bool ParseTOKEN( const wchar_t * sch, const wchar_t *& ech );
+
+    /**
+     * The TOKEN of the tag name [sch, sch+len) (ignoring case) and its
+     * heading or list level. Returns false for an unknown tag.
+     **/
+    static bool lookupTag( const wchar_t * sch, size_t len, TOKEN & token, int & level );
+    void addTextOp( OpKind kind, const wchar_t * sch, const wchar_t * ech );
+    void MeasurePre( const wchar_t * sch, unsigned & width );
+
 private:
 
     static const unsigned listindent;
@@ -103,7 +154,7 @@ private:
 
     void PadChangeLevel( bool down, int tag );
     void PadSetLevel();
-    size_t textWidth( std::wstring wstr );
+    size_t textWidth( const wchar_t * wstr, size_t len );
 
 private:
 
@@ -121,9 +172,12 @@ private:
 
 	std::wstring target;
 
+	bool visited;	// was armed (drawn as visitedlink)
+
 	Anchor()
 	{
 	    sline = scol = eline = ecol = unset;
+	    visited = false;
 	}
 
 	Anchor( int sl, int sc )
@@ -137,6 +191,7 @@ private:
 	    scol  = sc;
 	    eline = ecol = unset;
 	    target = L"";
+	    visited = false;
 	}
 
 	void close( int el, int ec )
@@ -163,24 +218,74 @@ private:
 	    return sline < nextinvisible && eline >= firstvisible;
 	}
 
-	void draw( NCPad & pad, const chtype attr, int color );
+	static bool endsBefore( const Anchor & anchor, unsigned line )
+	{
+	    return anchor.eline < line;
+	}
+
+	static bool startsBefore( const Anchor & anchor, unsigned line )
+	{
+	    return anchor.sline < line;
+	}
+
+	/** Draw the part of the anchor in \a line at \a row of \a w. */
+	void draw( NCursesWindow & w, int row, unsigned line, const chtype attr, int color );
     };
 
     static const bool showLinkTarget;
 
     Anchor		canchor;
-    std::vector<Anchor>	anchors;
     unsigned		armed;
 
+    /**
+     * The anchors in the order they are laid out. Anchors do not nest,
+     * so both their start and their end lines ascend: the anchors in
+     * some lines are found by binary search (see firstAnchorEnding and
+     * firstAnchorStarting).
+     **/
+    std::vector<Anchor>	anchors;
+
+    /** The first anchor ending in or after \a line (or anchors.size()). */
+    unsigned firstAnchorEnding( unsigned line ) const;
+
+    /** The first anchor starting in or after \a line (or anchors.size()). */
+    unsigned firstAnchorStarting( unsigned line ) const;
+
     unsigned vScrollFirstvisible;
     unsigned vScrollNextinvisible;
 
-    void openAnchor( std::wstring args );
+    static void anchorTarget( const wchar_t * sch, const wchar_t * ech, std::wstring & out );
+    void openAnchor( const std::wstring & target );
     void closeAnchor();
 
     void arm( unsigned i );
     void disarm() { arm( Anchor::unset ); }
 
+private:
+
+    /**
+     * The laid out text, as runs of characters drawn with the same
+     * attribute, per line. The pad is virtual: just the lines visible
+     * in its window are drawn from the runs (see drawLine), so the
+     * costs of a redraw do not depend on the size of the text.
+     **/
+    struct Run
+    {
+	unsigned col;
+	unsigned width;
+	chtype	 attr;
+	unsigned start;		// the characters in runtext
+	unsigned len;
+    };
+
+    std::vector<Run>	  runs;
+    std::vector<unsigned> lineRuns;	// the first run of each line
+    std::wstring	  runtext;
+
+    void clearRuns();
+    void addRun( const wchar_t * sch, unsigned len );
+    void drawLine( NCursesWindow & w, const wrect at, unsigned line );
+
 private:
 
     void PadSetAttr();
@@ -193,8 +298,45 @@ private:
     void PadWS( const bool tab = false );
     void PadTXT( const wchar_t * sch, const unsigned len );
     void PadPreTXT( const wchar_t * sch, const unsigned len );
-    void AdjustPrePad( const wchar_t * sch );
-    bool PadTOKEN( const wchar_t * sch, const wchar_t *& ech );
+    void AdjustPrePad( unsigned width );
+    void PadTOKEN( const Op & op );
+    void PadOp( const Op & op );
+    void PadOps( unsigned first, unsigned last );
+
+private:
+
+    /**
+     * Lays out a large text while the UI is idle: the first screen is
+     * laid out at once (see DrawHTMLPad), the rest in slices. The
+     * scroll range grows as the lines become ready.
+     **/
+    class LayoutJob : public NCIdleHandler
+    {
+    public:
+
+	LayoutJob( NCRichText & r ) : richText( r ) {}
+
+	virtual bool idle() { return richText.layoutIdle(); }
+
+    private:
+
+	LayoutJob & operator=( const LayoutJob & );
+	LayoutJob( const LayoutJob & );
+
+	NCRichText & richText;
+    };
+
+    static const unsigned backgroundLayoutMin;	// characters
+    static const unsigned layoutSliceChars;
+    static const unsigned layoutSliceOps;
+
+    LayoutJob layoutJob;
+    bool      backgroundLayout;
+    bool      layoutPending;
+
+    bool layoutStep();
+    bool layoutIdle();
+    void stopLayout();
 
 protected:
 
@@ -228,6 +370,29 @@ public:
 
     virtual void setValue( const std::string & ntext );
 
+    /**
+     * Append \a ntext to the text. Just the new text is parsed and laid
+     * out, continuing where the text laid out so far ends (the open
+     * tags, lists and anchors, the last line). The tag, word, entity
+     * or white space at the end of \a ntext may be cut, so it is shown
+     * with the text of the next call (or when the text is laid out
+     * again, e.g. on a resize).
+     *
+     * The appended text is added to value() once it is as long as the
+     * value, so appending costs the size of \a ntext. The "Value"
+     * property always includes it.
+     **/
+    void appendValue( const std::string & ntext );
+
+    virtual YPropertyValue getProperty( const std::string & propertyName );
+
+    /**
+     * Whether to lay out a text of more than backgroundLayoutMin
+     * characters in the background, so the first screen can be read
+     * and scrolled right away. On by default.
+     **/
+    void setBackgroundLayout( bool enable ) { backgroundLayout = enable; }
+
     virtual void setEnabled( bool do_bv );
 
     virtual bool setKeyboardFocus()
@@ -147,7 +147,7 @@ void NCSelectionBox::addItem( YItem * item )
     if ( item )
     {
 	YSelectionBox::addItem( item );
-	Items[0] = new NCTableCol( item->label() );
+	Items[0] = new ( myPad()->arena() ) NCTableCol( item->label() );
 	myPad()->Append( Items );
 	DrawPad();
 
@@ -163,6 +163,14 @@ void NCSelectionBox::addItem( const std::string & description, bool selected )
 }
 
 
+// Add all items, but redraw just once
+void NCSelectionBox::addItems( const YItemCollection & itemCollection )
+{
+    UpdateGuard batch( *this );
+    YSelectionBox::addItems( itemCollection );
+}
+
+
 void NCSelectionBox::setLabel( const std::string & nlabel )
 {
     YSelectionBox::setLabel( nlabel );
@@ -68,6 +68,10 @@ public:
 
     virtual void addItem( YItem *item );
     virtual void addItem( const std::string & itemLabel, bool selected = false );
+    virtual void addItems( const YItemCollection & itemCollection );
+
+    virtual void startMultipleChanges() { startMultidraw(); }
+    virtual void doneMultipleChanges()	{ stopMultidraw(); }
 
     virtual int preferredWidth();
     virtual int preferredHeight();
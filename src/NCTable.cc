@@ -29,6 +29,8 @@
 #include <yui/YMenuButton.h>
 #include <yui/YTypes.h>
 
+#include <cwctype>
+
 using std::endl;
 
 /*
@@ -50,6 +52,8 @@ NCTable::NCTable( YWidget * parent, YTableHeader *tableHeader, bool multiSelecti
     , NCPadWidget( parent )
     , biglist( false )
     , multiselect( multiSelection )
+    , filterOn( false )
+    , filterMode( false )
 {
     yuiDebug() << std::endl;
 
@@ -230,34 +234,38 @@ void NCTable::addItem( YItem *yitem, bool allAtOnce )
     std::vector<NCTableCol*> Items( itemCount );
     unsigned int i = 0;
 
+    // lines and columns are allocated from the pad
+    NCTableArena * arena = myPad()->arena();
+
     if ( !multiselect )
     {
-	// Iterate over cells to create columns
+	// Iterate over cells to create columns (the labels are recoded
+	// from UTF-8 when first needed, see NCTableCol)
 	for ( YTableCellIterator it = item->cellsBegin();
 	      it != item->cellsEnd();
 	      ++it )
 	{
-	    Items[i] = new NCTableCol( NCstring(( *it )->label() ) );
+	    Items[i] = new ( arena ) NCTableCol( ( *it )->label() );
 	    i++;
 	}
     }
     else
     {
 	// Create the tag first
-	Items[0] = new NCTableTag( yitem, yitem->selected() );
+	Items[0] = new ( arena ) NCTableTag( yitem, yitem->selected() );
 	i++;
 	// and then iterate over cells
 	for ( YTableCellIterator it = item->cellsBegin();
 	      it != item->cellsEnd();
 	      ++it )
 	{
-	    Items[i] = new NCTableCol( NCstring(( *it )->label() ) );
+	    Items[i] = new ( arena ) NCTableCol( ( *it )->label() );
 	    i++;
 	}
     }
 
     //Insert @idx
-    NCTableLine *newline = new NCTableLine( Items, item->index() );
+    NCTableLine *newline = new ( arena ) NCTableLine( Items, item->index() );
 
     YUI_CHECK_PTR( newline );
 
@@ -283,6 +291,7 @@ void NCTable::addItem( YItem *yitem, bool allAtOnce )
 // call)
 void NCTable::addItems( const YItemCollection & itemCollection )
 {
+    UpdateGuard batch( *this );
 
     for ( YItemConstIterator it = itemCollection.begin();
 	  it != itemCollection.end();
@@ -290,7 +299,6 @@ void NCTable::addItems( const YItemCollection & itemCollection )
     {
 	addItem( *it, true);
     }
-    DrawPad();
 }
 
 // Clear the table (in terms of YTable and visually)
@@ -304,15 +312,35 @@ void NCTable::deleteAllItems()
 
 
 
+// Show the rows of a model instead of items
+
+void NCTable::setModel( NCTableModel * model )
+{
+    // the items refer to the lines of the pad
+    deleteAllItems();
+    myPad()->setModel( model );
+    DrawPad();
+}
+
+
+
 // Return index of currently selected table item
 
 int NCTable::getCurrentItem()
 {
+    // the row of the model
+    if ( myPad()->hasModel() )
+	return myPad()->CurrentIndex();
+
     if ( !myPad()->Lines() )
 	return -1;
 
-    return keepSorting() ? myPad()->GetLine( myPad()->CurPos().L )->getIndex()
-	   : myPad()->CurPos().L;
+    const NCTableLine *cline = myPad()->GetCurrentLine();
+
+    if ( !cline )
+	return -1;
+
+    return keepSorting() ? cline->getIndex() : myPad()->CurrentIndex();
 
 }
 
@@ -322,7 +350,7 @@ int NCTable::getCurrentItem()
 
 YItem * NCTable::getCurrentItemPointer()
 {
-    const NCTableLine *cline = myPad()->GetLine( myPad()->CurPos().L );
+    const NCTableLine *cline = myPad()->GetCurrentLine();
 
     if ( cline )
 	return cline->origItem();
@@ -336,7 +364,7 @@ YItem * NCTable::getCurrentItemPointer()
 
 void NCTable::setCurrentItem( int index )
 {
-    myPad()->ScrlLine( index );
+    myPad()->ScrlToIndex( index );
 }
 
 
@@ -354,8 +382,8 @@ void NCTable::selectItem( YItem *yitem, bool selected )
     NCTableLine *line = ( NCTableLine * )item->data();
     YUI_CHECK_PTR( line );
 
-    const NCTableLine *current_line = myPad()->GetLine( myPad()->CurPos().L );
-    YUI_CHECK_PTR( current_line );
+    // none if the filter hides all lines or a model is shown
+    const NCTableLine *current_line = myPad()->GetCurrentLine();
 
     if ( !multiselect )
     {
@@ -392,7 +420,7 @@ void NCTable::selectItem( YItem *yitem, bool selected )
 
 void NCTable::selectCurrentItem()
 {
-    const NCTableLine *cline = myPad()->GetLine( myPad()->CurPos().L );
+    const NCTableLine *cline = myPad()->GetCurrentLine();
 
     if ( cline )
 	YTable::selectItem( cline->origItem(), true );
@@ -411,6 +439,9 @@ void NCTable::deselectAllItems()
     }
     else
     {
+        // redraw just once for all items
+        UpdateGuard batch( *this );
+
         YItemCollection itemCollection = YTable::selectedItems();
         for ( YItemConstIterator it = itemCollection.begin();
               it != itemCollection.end(); ++it )
@@ -503,7 +534,7 @@ NCursesEvent NCTable::wHandleInput( wint_t key )
     int citem  = getCurrentItem();
     bool sendEvent = false;
 
-    if ( ! handleInput( key ) )
+    if ( ! handleFilterInput( key ) && ! handleInput( key ) )
     {
 	switch ( key )
 	{
@@ -592,3 +623,41 @@ void NCTable::toggleCurrentItem()
 	selectItem( it, !( it->selected() ) );
     }
 }
+
+
+
+void NCTable::setFilterEnabled( bool enabled )
+{
+    filterOn = enabled;
+
+    if ( !enabled && ( filterMode || myPad()->filtered() ) )
+    {
+	filterMode = false;
+	myPad()->setFilterPrompt( false );
+	myPad()->setFilter( std::wstring() );
+    }
+}
+
+
+
+// Type-to-filter (if enabled): '/' starts entering a filter, every key
+// typed narrows the lines shown. Return keeps the filter, Esc drops it.
+
+bool NCTable::handleFilterInput( wint_t key )
+{
+    if ( !filterOn )
+	return false;
+
+    bool wasFilterMode = filterMode;
+    std::wstring filter( myPad()->filter() );
+
+    bool handled = NCTableFilterIndex::editFilter( key, filterMode, filter );
+
+    if ( filterMode != wasFilterMode || handled )
+	myPad()->setFilterPrompt( filterMode );
+
+    if ( handled && wasFilterMode )
+	myPad()->setFilter( filter );
+
+    return handled;
+}
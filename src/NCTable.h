@@ -94,6 +94,26 @@ public:
 
     void setSortStrategy( NCTableSortStrategyBase * newStrategy ) { myPad()->setSortStrategy( newStrategy ); }
 
+    /**
+     * Enable type-to-filter: '/' starts entering a filter that narrows
+     * the lines shown. Off by default, so '/' reaches the table (e.g. a
+     * file selection). Disabling it drops the filter.
+     */
+    void setFilterEnabled( bool enabled );
+
+    bool filterEnabled() const { return filterOn; }
+
+    /**
+     * Show the rows of \a model (dyn. allocated, owned by the table)
+     * instead of the items, e.g. for huge lists. Just the rows on screen
+     * are requested from the model. getCurrentItem() returns the row of
+     * the model. Any items are deleted. \c 0 returns to showing items.
+     */
+    void setModel( NCTableModel * model );
+
+    /** Call after the rows of the model changed. */
+    void modelChanged() { myPad()->modelChanged(); }
+
 protected:
 
     /**
@@ -104,6 +124,8 @@ protected:
 
     bool	  biglist;
     bool 	  multiselect;
+    bool	  filterOn;
+    bool	  filterMode;
 
 
 protected:
@@ -123,6 +145,9 @@ protected:
     virtual void addItem( YItem *yitem, bool allAtOnce );
     void toggleCurrentItem();
 
+    /** Handle \a key if it starts or edits the filter of the table. */
+    bool handleFilterInput( wint_t key );
+
 private:
 
     std::vector<NCstring> _header;
@@ -28,16 +28,194 @@
 #include "stringutil.h"
 #include "stdutil.h"
 
+#include <algorithm>
+#include <cctype>
+
 using stdutil::form;
 
 
+// The blocks of all arenas by their address, to find the arena of an
+// object without a header (see NCTableArena::of).
+static std::map<const char *, NCTableArena *> & arenaBlocks()
+{
+    static std::map<const char *, NCTableArena *> blocks;
+    return blocks;
+}
+
+
+NCTableArena::NCTableArena()
+	: used( BLOCK_SIZE )
+	, live( 0 )
+{
+}
+
+
+NCTableArena::~NCTableArena()
+{
+    clear();
+}
+
+
+void NCTableArena::clear()
+{
+    if ( live )
+    {
+	yuiWarning() << live << " objects still alive, keeping the arena" << std::endl;
+	return;
+    }
+
+    for ( unsigned i = 0; i < blocks.size(); ++i )
+    {
+	arenaBlocks().erase( blocks[i] );
+	delete [] blocks[i];
+    }
+
+    blocks.clear();
+    freeList.clear();
+    used = BLOCK_SIZE;
+}
+
+
+void * NCTableArena::get( std::size_t size )
+{
+    unsigned slot = size / ALIGN;
+
+    ++live;
+
+    if ( slot < freeList.size() && freeList[slot] )
+    {
+	void * ptr = freeList[slot];
+	freeList[slot] = *( void ** )ptr;
+	return ptr;
+    }
+
+    if ( used + size > BLOCK_SIZE )
+    {
+	blocks.push_back( new char[BLOCK_SIZE] );
+	arenaBlocks()[ blocks.back() ] = this;
+	used = 0;
+    }
+
+    void * ptr = blocks.back() + used;
+    used += size;
+    return ptr;
+}
+
+
+void NCTableArena::put( void * ptr, std::size_t size )
+{
+    --live;
+
+    unsigned slot = size / ALIGN;
+
+    if ( slot >= freeList.size() )
+	freeList.resize( slot + 1, 0 );
+
+    *( void ** )ptr = freeList[slot];
+    freeList[slot] = ptr;
+}
+
+
+void * NCTableArena::allocate( std::size_t size, NCTableArena * arena )
+{
+    if ( !arena || size > BLOCK_SIZE )
+	return ::operator new( size );
+
+    return arena->get( ( size + ALIGN - 1 ) / ALIGN * ALIGN );
+}
+
+
+void NCTableArena::deallocate( void * ptr, std::size_t size )
+{
+    if ( !ptr )
+	return;
+
+    NCTableArena * arena = of( ptr );
+
+    if ( arena )
+	arena->put( ptr, ( size + ALIGN - 1 ) / ALIGN * ALIGN );
+    else
+	::operator delete( ptr );
+}
+
+
+void NCTableArena::abandon( void * ptr, NCTableArena * arena )
+{
+    if ( of( ptr ) )
+	--arena->live;
+    else
+	::operator delete( ptr );
+}
+
+
+NCTableArena * NCTableArena::of( const void * ptr )
+{
+    const std::map<const char *, NCTableArena *> & all( arenaBlocks() );
+    std::map<const char *, NCTableArena *>::const_iterator it = all.upper_bound( ( const char * )ptr );
+
+    if ( it == all.begin() )
+	return 0;
+
+    --it;
+    return ( const char * )ptr < it->first + BLOCK_SIZE ? it->second : 0;
+}
+
+
+
 NCTableCol::NCTableCol( const NCstring & l, const STYLE & st )
 	: label( l )
+	, recoded( true )
 	, style( st )
 {
 }
 
 
+NCTableCol::NCTableCol( const std::string & l, const STYLE & st )
+	: utf8( l )
+	, recoded( false )
+	, style( st )
+{
+}
+
+
+void NCTableCol::recode() const
+{
+    label = NClabel( NCstring( utf8 ) );
+    recoded = true;
+    std::string().swap( utf8 );
+}
+
+
+wsze NCTableCol::Size() const
+{
+    if ( !recoded )
+    {
+	// plain ASCII is measured like NCtext::Columns does
+	size_t width  = 0;
+	size_t lwidth = 0;
+	std::string::const_iterator it;
+
+	for ( it = utf8.begin(); it != utf8.end() && ( unsigned char )*it < 0x80; ++it )
+	{
+	    if ( *it == '\n' )
+	    {
+		width  = std::max( width, lwidth );
+		lwidth = 0;
+	    }
+	    else if ( *it == '\t' )
+		lwidth += NCurses::tabsize();
+	    else if ( isprint( *it ) )
+		++lwidth;
+	}
+
+	if ( it == utf8.end() )
+	    return wsze( 1, std::max( width, lwidth ) );
+    }
+
+    return wsze( 1, Label().width() );
+}
+
+
 NCTableCol::~NCTableCol()
 {
 }
@@ -70,13 +248,13 @@ void NCTableCol::DrawAt( NCursesWindow & w, const wrect at,
     if ( hbg == NCTableStyle::currentBG )
 	hbg = bg;
 
-    label.drawAt( w, bg, hbg, at, tableStyle.ColAdjust( colidx ) );
+    Label().drawAt( w, bg, hbg, at, tableStyle.ColAdjust( colidx ) );
 }
 
 
 std::ostream & operator<<( std::ostream & STREAM, const NCTableCol & OBJ )
 {
-    return STREAM << OBJ.label;
+    return STREAM << OBJ.Label();
 }
 
 
@@ -186,17 +364,28 @@ NCTableCol * NCTableLine::GetCol( unsigned idx )
 void NCTableLine::UpdateFormat( NCTableStyle & tableStyle )
 {
     tableStyle.AssertMinCols( Cols() );
+    fmtWidth.assign( Cols(), 0 );
 
     for ( unsigned c = 0; c < Cols(); ++c )
     {
 	if ( !Items[c] )
 	    continue;
 
-	tableStyle.MinColWidth( c, Items[c]->Size().W );
+	fmtWidth[c] = Items[c]->Size().W;
+	tableStyle.AddColWidth( c, fmtWidth[c] );
     }
 }
 
 
+void NCTableLine::ClearFormat( NCTableStyle & tableStyle )
+{
+    for ( unsigned c = 0; c < fmtWidth.size(); ++c )
+	tableStyle.DelColWidth( c, fmtWidth[c] );
+
+    fmtWidth.clear();
+}
+
+
 void NCTableLine::DrawAt( NCursesWindow & w, const wrect at,
 			  NCTableStyle & tableStyle,
 			  bool active ) const
@@ -349,6 +538,7 @@ bool NCTableStyle::SetStyleFrom( const std::vector<NCstring> & head )
 
     colWidth.clear();
     colAdjust.clear();
+    colStat.clear();
     AssertMinCols( ncols );
 
     bool hasContent = false;
@@ -394,6 +584,39 @@ bool NCTableStyle::SetStyleFrom( const std::vector<NCstring> & head )
 }
 
 
+void NCTableStyle::AddColWidth( unsigned num, unsigned val )
+{
+    if ( !val )
+	return;
+
+    AssertMinCols( num + 1 );
+    ++colStat[num][val];
+
+    if ( val > colWidth[num] )
+	colWidth[num] = val;
+}
+
+
+void NCTableStyle::DelColWidth( unsigned num, unsigned val )
+{
+    if ( !val || num >= colStat.size() )
+	return;
+
+    std::map<unsigned, unsigned>::iterator it = colStat[num].find( val );
+
+    if ( it == colStat[num].end() )
+	return;
+
+    if ( --it->second == 0 )
+    {
+	colStat[num].erase( it );
+
+	if ( val == colWidth[num] )
+	    colWidth[num] = colStat[num].empty() ? 0 : colStat[num].rbegin()->first;
+    }
+}
+
+
 chtype NCTableStyle::highlightBG( const NCTableLine::STATE lstate,
 				  const NCTableCol::STYLE  cstyle,
 				  const NCTableCol::STYLE  dstyle ) const
@@ -27,6 +27,8 @@
 
 #include <iosfwd>
 #include <vector>
+#include <map>
+#include <cstddef>
 
 #include "position.h"
 #include "NCWidget.h"
@@ -36,6 +38,63 @@ class NCTableStyle;
 class NCTableCol;
 
 
+/**
+ * Slab allocator for the NCTableLines and NCTableCols of a pad, so
+ * neighbouring rows sit next to each other in memory. Objects are
+ * allocated via \c new(arena); deleted ones go to a free list per
+ * size. Once the pad dropped all its lines, \ref clear releases all
+ * blocks at once.
+ *
+ * Just the objects themselves come from the arena: their vectors and
+ * labels still live on the heap. Objects allocated by plain \c new
+ * (i.e. with no arena) live on the heap as usual, with no overhead.
+ **/
+class NCTableArena
+{
+    NCTableArena & operator=( const NCTableArena & );
+    NCTableArena( const NCTableArena & );
+
+public:
+
+    NCTableArena();
+    ~NCTableArena();
+
+    /** Release all blocks. Does nothing while objects are alive. */
+    void clear();
+
+    /** Allocate \a size bytes from \a arena (or the heap if \c 0). */
+    static void * allocate( std::size_t size, NCTableArena * arena );
+
+    /** Free the \a size bytes at \a ptr returned by \ref allocate. */
+    static void deallocate( void * ptr, std::size_t size );
+
+    /** Drop \a ptr allocated from \a arena, whose size is unknown (a
+     * constructor threw). Its memory is reused after \ref clear.
+     */
+    static void abandon( void * ptr, NCTableArena * arena );
+
+    /** The arena \a ptr was allocated from (or \c 0). */
+    static NCTableArena * of( const void * ptr );
+
+private:
+
+    enum
+    {
+	ALIGN	   = alignof( std::max_align_t ),
+	BLOCK_SIZE = 64 * 1024
+    };
+
+    void * get( std::size_t size );
+    void   put( void * ptr, std::size_t size );
+
+    std::vector<char*> blocks;
+    std::size_t        used;		// in the last block
+    std::size_t        live;		// objects allocated
+    std::vector<void*> freeList;	// by size / ALIGN
+};
+
+
+
 class NCTableLine
 {
 
@@ -66,6 +125,11 @@ private:
 
     YTableItem *yitem;
 
+    /** The column widths this line contributed to the NCTableStyle
+     * in the last \ref UpdateFormat (see \ref ClearFormat).
+     */
+    std::vector<unsigned> fmtWidth;
+
 protected:
 
     mutable STATE vstate;
@@ -75,6 +139,19 @@ protected:
 
 public:
 
+    static void * operator new( std::size_t size )
+    { return NCTableArena::allocate( size, 0 ); }
+
+    static void * operator new( std::size_t size, NCTableArena * arena )
+    { return NCTableArena::allocate( size, arena ); }
+
+    // sized, so the arena needs no header per object
+    static void operator delete( void * ptr, std::size_t size )
+    { NCTableArena::deallocate( ptr, size ); }
+
+    static void operator delete( void * ptr, NCTableArena * arena )
+    { NCTableArena::abandon( ptr, arena ); }
+
     NCTableLine( unsigned cols, int index = -1, const unsigned s = S_NORMAL );
     NCTableLine( std::vector<NCTableCol*> & nItems, int index = -1, const unsigned s = S_NORMAL );
     void setOrigItem( YTableItem *it );
@@ -129,6 +206,11 @@ public:
 
     virtual void UpdateFormat( NCTableStyle & TableStyle );
 
+    /** Withdraw the column widths recorded by the last \ref UpdateFormat
+     * from \a TableStyle, e.g. before the line is changed or deleted.
+     */
+    void ClearFormat( NCTableStyle & TableStyle );
+
     virtual void DrawAt( NCursesWindow & w, const wrect at,
 			 NCTableStyle & tableStyle,
 			 bool active ) const;
@@ -157,19 +239,52 @@ public:
 
 private:
 
-    NClabel label;
-    STYLE   style;
+    mutable NClabel	label;
+    mutable std::string utf8;		// the label until recoded
+    mutable bool	recoded;
+    STYLE		style;
+
+    void recode() const;
 
 public:
 
+    static void * operator new( std::size_t size )
+    { return NCTableArena::allocate( size, 0 ); }
+
+    static void * operator new( std::size_t size, NCTableArena * arena )
+    { return NCTableArena::allocate( size, arena ); }
+
+    // sized, so the arena needs no header per object
+    static void operator delete( void * ptr, std::size_t size )
+    { NCTableArena::deallocate( ptr, size ); }
+
+    static void operator delete( void * ptr, NCTableArena * arena )
+    { NCTableArena::abandon( ptr, arena ); }
+
     NCTableCol( const NCstring & l = "", const STYLE & st = ACTIVEDATA );
+
+    /**
+     * Keep the UTF-8 encoded label \a l and recode it just when needed,
+     * i.e. when the cell is drawn or its text is requested. Plain ASCII
+     * labels are measured without recoding.
+     */
+    NCTableCol( const std::string & l, const STYLE & st = ACTIVEDATA );
+
     virtual ~NCTableCol();
 
-    const NClabel & Label() const { return label; }
+    const NClabel & Label() const { assertLabel(); return label; }
+
+    virtual void SetLabel( const NClabel & l )
+    {
+	label = l;
+	recoded = true;
+	std::string().swap( utf8 );
+    }
 
-    virtual void SetLabel( const NClabel & l ) { label = l; }
+    void stripHotkey() { assertLabel(); label.stripHotkey(); }
 
-    void stripHotkey() { label.stripHotkey(); }
+    /** Recode the label now. Needed before other threads read it. */
+    void assertLabel() const { if ( !recoded ) recode(); }
 
 protected:
 
@@ -180,16 +295,16 @@ protected:
 
 public:
 
-    virtual wsze Size() const { return wsze( 1, label.width() ); }
+    virtual wsze Size() const;
 
     virtual void DrawAt( NCursesWindow & w, const wrect at,
 			 NCTableStyle & tableStyle,
 			 NCTableLine::STATE linestate,
 			 unsigned colidx ) const;
 
-    bool	  hasHotkey() const { return label.hasHotkey(); }
+    bool	  hasHotkey() const { return Label().hasHotkey(); }
 
-    unsigned char hotkey()    const { return label.hotkey(); }
+    unsigned char hotkey()    const { return Label().hotkey(); }
 };
 
 
@@ -225,6 +340,12 @@ private:
     std::vector<unsigned>	colWidth;
     std::vector<NC::ADJUST>	colAdjust;
 
+    /** Per column: the number of lines having a certain width. This allows
+     * to adjust colWidth if a single line is added, changed or removed,
+     * without measuring the whole table again.
+     */
+    std::vector< std::map<unsigned, unsigned> > colStat;
+
     const NCWidget & parw;
 
     unsigned colSepwidth;
@@ -251,6 +372,7 @@ public:
     void ResetToMinCols()
     {
 	colWidth.clear();
+	colStat.clear();
 	AssertMinCols( headline.Cols() );
 	headline.UpdateFormat( *this );
     }
@@ -262,8 +384,17 @@ public:
 	    colWidth.resize( num, 0 );
 	    colAdjust.resize( colWidth.size(), NC::LEFT );
 	}
+
+	if ( colStat.size() < colWidth.size() )
+	    colStat.resize( colWidth.size() );
     }
 
+    /** Record a line having width \a val in column \a num. */
+    void AddColWidth( unsigned num, unsigned val );
+
+    /** Withdraw a width recorded by \ref AddColWidth. */
+    void DelColWidth( unsigned num, unsigned val );
+
     void MinColWidth( unsigned num, unsigned val )
     {
 	AssertMinCols( num );
@@ -0,0 +1,58 @@
+/*
+  Copyright (C) 2000-2012 Novell, Inc
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) version 3.0 of the License. This library
+  is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+  License for more details. You should have received a copy of the GNU
+  Lesser General Public License along with this library; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+  Floor, Boston, MA 02110-1301 USA
+*/
+
+
+/*-/
+
+   File:       NCTableModel.h
+
+/-*/
+
+#ifndef NCTableModel_h
+#define NCTableModel_h
+
+#include <string>
+
+
+/**
+ * Provides the rows of a NCTable that is too large or changes too
+ * often to create a YTableItem and NCTableLine per row (e.g. process
+ * lists or journal entries). The table asks just for the cells of the
+ * rows on screen, so memory does not grow with the number of rows.
+ *
+ * After the rows changed, call NCTable::modelChanged.
+ **/
+class NCTableModel
+{
+public:
+
+    virtual ~NCTableModel() {}
+
+    /** The number of rows. */
+    virtual unsigned rowCount() const = 0;
+
+    /** The UTF-8 encoded text of the cell in \a row and \a col. */
+    virtual std::string cellText( unsigned row, unsigned col ) const = 0;
+
+    /**
+     * The display width to reserve for column \a col. The table does
+     * not measure the cells. Wider cells are truncated, a column is at
+     * least as wide as its header.
+     */
+    virtual unsigned widthHint( unsigned /*col*/ ) const { return 0; }
+};
+
+
+#endif // NCTableModel_h
@@ -26,20 +26,560 @@
 #include <yui/YUILog.h>
 #include "NCTablePad.h"
 #include "NCPopupMenu.h"
+#include "NCi18n.h"
+#include "stdutil.h"
+#include "NCwidth.h"
 
 #include <limits.h>
+#include <algorithm>
+#include <cwchar>
+#include <thread>
+#include <functional>
+#include <cwctype>
 
+using stdutil::form;
 
+// Tables with at least this many lines are sorted by several threads
+#define PARALLEL_SORT_LINES	10000
+#define MAX_SORT_WORKERS	8U
+
+// Tables with at least this many lines are sorted in the background
+#define BACKGROUND_SORT_LINES	20000
+
+
+void NCTableSortStrategyBase::prepareSort( std::vector<NCTableLine *>::iterator itemsBegin,
+					   std::vector<NCTableLine *>::iterator itemsEnd,
+					   int uiColumn )
+{
+    for ( std::vector<NCTableLine *>::iterator it = itemsBegin; it != itemsEnd; ++it )
+    {
+	const NCTableCol * col = ( *it )->GetCol( uiColumn );
+
+	if ( col )
+	    col->assertLabel();
+    }
+}
+
+
+
+void NCTableSortDefault::prepareSort( std::vector<NCTableLine *>::iterator itemsBegin,
+				      std::vector<NCTableLine *>::iterator itemsEnd,
+				      int uiColumn )
+{
+    NCTableSortStrategyBase::prepareSort( itemsBegin, itemsEnd, uiColumn );
+
+    for ( unsigned i = 0; i < _secondary.size(); ++i )
+	NCTableSortStrategyBase::prepareSort( itemsBegin, itemsEnd, _secondary[i] );
+}
+
+
+
+// Compute the sort key of the cell in uiCol. The collation key is
+// appended to the flat collKeys buffer.
+NCTableSortDefault::SortKey NCTableSortDefault::makeKey( std::vector<wchar_t> & collKeys,
+							 const NCTableLine * line,
+							 int uiCol )
+{
+    static const std::wstring empty;
+
+    const NCTableCol * col = line->GetCol( uiCol );
+    const std::wstring & text( col && !col->Label().getText().empty()
+			       ? col->Label().getText().begin()->str()
+			       : empty );
+    SortKey key;
+    wchar_t *endptr = 0;
+
+    key.number   = std::wcstol( text.c_str(), &endptr, 10 );
+    key.isNumber = ( *endptr == L'\0' );
+    key.collKey  = collKeys.size();
+
+    size_t len = std::wcsxfrm( 0, text.c_str(), 0 );
+    collKeys.resize( key.collKey + len + 1 );
+    std::wcsxfrm( &collKeys[ key.collKey ], text.c_str(), len + 1 );
+
+    return key;
+}
+
+
+
+// Extract the keys of the lines in chunk n and sort them.
+void NCTableSortDefault::sortChunk( std::vector<NCTableLine *>::iterator itemsBegin,
+				    const std::vector<int> & cols,
+				    std::vector<SortKey> & keys,
+				    std::vector< std::vector<wchar_t> > & collKeys,
+				    std::vector<unsigned> & order,
+				    unsigned chunk,
+				    unsigned n )
+{
+    unsigned first = n * chunk;
+    unsigned last  = std::min( first + chunk, ( unsigned )order.size() );
+
+    for ( unsigned r = first; r < last; ++r )
+    {
+	if ( ( r - first ) % 1024 == 0 )
+	{
+	    if ( canceled() )
+		return;
+
+	    if ( n == 0 )
+		setProgress( 50 * ( r - first ) / ( last - first ) );
+	}
+
+	order[r] = r;
+
+	for ( unsigned c = 0; c < cols.size(); ++c )
+	    keys[ r * cols.size() + c ] = makeKey( collKeys[n], itemsBegin[r], cols[c] );
+    }
+
+    std::stable_sort( order.begin() + first, order.begin() + last,
+		      Compare( keys, collKeys, chunk, cols.size() ) );
+}
+
+
+
+// Merge the sorted ranges [lo, lo+width) and [lo+width, lo+2*width) for
+// lo = first, first+step, ...
+void NCTableSortDefault::mergeChunks( const Compare & compare,
+				      std::vector<unsigned> & order,
+				      unsigned first,
+				      unsigned width,
+				      unsigned step )
+{
+    unsigned rows = order.size();
+
+    for ( unsigned lo = first; lo < rows && !canceled(); lo += step )
+    {
+	unsigned mid = std::min( lo + width, rows );
+	unsigned hi  = std::min( lo + 2 * width, rows );
+
+	if ( mid < hi )
+	    std::inplace_merge( order.begin() + lo, order.begin() + mid, order.begin() + hi, compare );
+    }
+}
+
+
+
+void NCTableSortDefault::sort( std::vector<NCTableLine *>::iterator itemsBegin,
+			       std::vector<NCTableLine *>::iterator itemsEnd,
+			       int uiColumn )
+{
+    unsigned rows = itemsEnd - itemsBegin;
+
+    if ( rows < 2 )
+	return;
+
+    std::vector<int> cols( 1, uiColumn );
+
+    for ( unsigned i = 0; i < _secondary.size(); ++i )
+    {
+	if ( std::find( cols.begin(), cols.end(), _secondary[i] ) == cols.end() )
+	    cols.push_back( _secondary[i] );
+    }
+
+    unsigned workers = 1;
+
+    if ( rows >= PARALLEL_SORT_LINES )
+	workers = std::max( 1U, std::min( std::thread::hardware_concurrency(), MAX_SORT_WORKERS ) );
+
+    unsigned chunk = ( rows + workers - 1 ) / workers;
+    workers = ( rows + chunk - 1 ) / chunk;
+
+    std::vector<SortKey> keys( rows * cols.size() );
+    std::vector< std::vector<wchar_t> > collKeys( workers );
+    std::vector<unsigned> order( rows );
+    std::vector<std::thread> threads;
+
+    setProgress( 0 );
+
+    // extract the keys once per line and sort the chunks in parallel
+    for ( unsigned n = 1; n < workers; ++n )
+    {
+	threads.push_back( std::thread( &NCTableSortDefault::sortChunk, this,
+					itemsBegin, std::cref( cols ), std::ref( keys ),
+					std::ref( collKeys ), std::ref( order ), chunk, n ) );
+    }
+
+    sortChunk( itemsBegin, cols, keys, collKeys, order, chunk, 0 );
+
+    for ( unsigned t = 0; t < threads.size(); ++t )
+	threads[t].join();
+
+    // merge the sorted chunks pairwise
+    Compare compare( keys, collKeys, chunk, cols.size() );
+    unsigned levels = 0;
+
+    for ( unsigned width = chunk; width < rows; width *= 2 )
+	++levels;
+
+    unsigned level = 0;
+
+    for ( unsigned width = chunk; width < rows && !canceled(); width *= 2 )
+    {
+	unsigned pairs = ( rows + 2 * width - 1 ) / ( 2 * width );
+	unsigned n = std::min( pairs, workers );
+
+	threads.clear();
+
+	for ( unsigned t = 1; t < n; ++t )
+	{
+	    threads.push_back( std::thread( &NCTableSortDefault::mergeChunks, this,
+					    std::cref( compare ), std::ref( order ),
+					    t * 2 * width, width, n * 2 * width ) );
+	}
+
+	mergeChunks( compare, order, 0, width, n * 2 * width );
+
+	for ( unsigned t = 0; t < threads.size(); ++t )
+	    threads[t].join();
+
+	setProgress( 50 + 50 * ++level / levels );
+    }
+
+    if ( canceled() )
+	return;
+
+    std::vector<NCTableLine *> sorted( rows );
+
+    for ( unsigned r = 0; r < rows; ++r )
+	sorted[r] = itemsBegin[ order[r] ];
+
+    std::copy( sorted.begin(), sorted.end(), itemsBegin );
+    setProgress( 100 );
+}
+
+
+
+// Runs a sort in a worker thread on a copy of the table lines. The
+// result is applied by the idle handler (i.e. in the UI thread) when
+// the sort is done.
+class NCTableSortJob : public NCIdleHandler
+{
+public:
+
+    NCTableSortJob( NCTablePad & pad,
+		    NCTableSortStrategyBase & strategy,
+		    const std::vector<NCTableLine*> & items,
+		    int column )
+	: pad( pad )
+	, strategy( strategy )
+	, items( items )
+	, done( false )
+	, shownProgress( -1 )
+    {
+	strategy.cancel( false );
+	worker = std::thread( &NCTableSortJob::run, this, column );
+	NCurses::AddIdleHandler( this );
+    }
+
+    virtual ~NCTableSortJob() { cancel(); }
+
+    void cancel()
+    {
+	NCurses::RemoveIdleHandler( this );
+	strategy.cancel();
+
+	if ( worker.joinable() )
+	    worker.join();
+    }
+
+    /** Wait for the sort to finish and apply its order. */
+    void finish()
+    {
+	NCurses::RemoveIdleHandler( this );
+
+	if ( worker.joinable() )
+	{
+	    worker.join();
+	    pad.finishSort( items );
+	}
+    }
+
+    bool running() const { return worker.joinable(); }
+
+    int progress() const { return strategy.progress(); }
+
+    virtual bool idle()
+    {
+	if ( !done )
+	{
+	    if ( progress() != shownProgress )
+	    {
+		shownProgress = progress();
+		pad.DrawHead();
+	    }
+
+	    return true;
+	}
+
+	worker.join();
+	pad.finishSort( items );
+	pad.update();
+	return false;
+    }
+
+private:
+
+    NCTableSortJob & operator=( const NCTableSortJob & );
+    NCTableSortJob( const NCTableSortJob & );
+
+    void run( int column )
+    {
+	strategy.sort( items.begin(), items.end(), column );
+	done = true;
+    }
+
+    NCTablePad & pad;
+    NCTableSortStrategyBase & strategy;
+    std::vector<NCTableLine*> items;
+    std::thread worker;
+    std::atomic<bool> done;
+    int shownProgress;
+};
+
+
+
+void NCTableFilterIndex::clear()
+{
+    texts.clear();
+    postings.clear();
+    stale = 0;
+}
+
+
+
+std::wstring NCTableFilterIndex::lineText( const NCTableLine * line )
+{
+    std::wstring text;
+
+    for ( unsigned c = 0; c < line->Cols(); ++c )
+    {
+	const NCTableCol * col = line->GetCol( c );
+
+	// the selection tag "[ ]" is no content
+	if ( !col || dynamic_cast<const NCTableTag *>( col ) )
+	    continue;
+
+	const std::list<NCstring> & label( col->Label().getText() );
+
+	for ( std::list<NCstring>::const_iterator it = label.begin(); it != label.end(); ++it )
+	{
+	    // separate the cells, so a pattern can't match across them
+	    if ( !text.empty() )
+		text += L'\n';
+
+	    text += it->str();
+	}
+    }
+
+    for ( std::wstring::iterator it = text.begin(); it != text.end(); ++it )
+	*it = std::towlower( *it );
+
+    return text;
+}
+
+
+
+void NCTableFilterIndex::update( const NCTableLine * line )
+{
+    update( line, lineText( line ) );
+}
+
+
+
+void NCTableFilterIndex::update( const void * key, std::wstring text )
+{
+    std::pair<std::unordered_map<const void *, Entry>::iterator, bool> ins
+	= texts.insert( std::make_pair( key, Entry() ) );
+    Entry & entry( ins.first->second );
+
+    if ( !ins.second )
+    {
+	if ( entry.text == text )
+	    return;
+
+	// the old postings remain and are sorted out in mark()
+	++stale;
+    }
+
+    entry.text.swap( text );
+    entry.mark = 0;
+
+    std::vector<Trigram> grams;
+    grams.reserve( 3 * entry.text.size() );
+
+    for ( unsigned n = 1; n <= 3; ++n )
+    {
+	for ( unsigned i = 0; i + n <= entry.text.size(); ++i )
+	    grams.push_back( trigram( entry.text.c_str() + i, n ) );
+    }
+
+    std::sort( grams.begin(), grams.end() );
+    grams.erase( std::unique( grams.begin(), grams.end() ), grams.end() );
+
+    for ( unsigned i = 0; i < grams.size(); ++i )
+	postings[ grams[i] ].push_back( key );
+}
+
+
+
+void NCTableFilterIndex::remove( const void * key )
+{
+    if ( texts.erase( key ) )
+	++stale;
+}
+
+
+
+unsigned NCTableFilterIndex::mark( const std::wstring & pattern, std::vector<const void *> * hits )
+{
+    if ( ++generation == 0 )
+	++generation;	// 0 is never a valid mark
+
+    if ( pattern.empty() )
+    {
+	// matches all lines
+	for ( std::unordered_map<const void *, Entry>::iterator it = texts.begin();
+	      it != texts.end(); ++it )
+	{
+	    if ( it->second.text.find( pattern ) != std::wstring::npos )
+	    {
+		it->second.mark = generation;
+
+		if ( hits )
+		    hits->push_back( it->first );
+	    }
+	}
+
+	return generation;
+    }
+
+    // just the lines listed for the rarest trigram of the pattern are
+    // candidates (a shorter pattern is looked up as a whole)
+    const std::vector<const void *> * candidates = 0;
+    unsigned n = std::min( pattern.size(), ( std::wstring::size_type )3 );
+
+    for ( unsigned i = 0; i + n <= pattern.size(); ++i )
+    {
+	std::unordered_map<Trigram, std::vector<const void *> >::const_iterator it
+	    = postings.find( trigram( pattern.c_str() + i, n ) );
+
+	if ( it == postings.end() )
+	    return generation;	// no line contains this trigram
+
+	if ( !candidates || it->second.size() < candidates->size() )
+	    candidates = &it->second;
+    }
+
+    for ( unsigned i = 0; i < candidates->size(); ++i )
+    {
+	// postings may be stale: verify against the current text
+	std::unordered_map<const void *, Entry>::iterator it = texts.find( ( *candidates )[i] );
+
+	// a key may be listed twice after an update: mark it once
+	if ( it != texts.end() && it->second.mark != generation
+	     && it->second.text.find( pattern ) != std::wstring::npos )
+	{
+	    it->second.mark = generation;
+
+	    if ( hits )
+		hits->push_back( it->first );
+	}
+    }
+
+    return generation;
+}
+
+
+
+bool NCTableFilterIndex::editFilter( wint_t key, bool & entering, std::wstring & filter )
+{
+    if ( !entering )
+    {
+	if ( key != L'/' )
+	    return false;
+
+	entering = true;
+	return true;
+    }
+
+    switch ( key )
+    {
+	case KEY_ESC:
+	    filter.clear();
+	    // fall through
+
+	case KEY_RETURN:
+	    entering = false;
+	    break;
+
+	case '\b':
+	case 0x7f:
+	case KEY_BACKSPACE:
+
+	    if ( filter.empty() )
+		entering = false;
+	    else
+		filter.erase( filter.size() - 1 );
+
+	    break;
+
+	default:
+	    bool is_special = false;
+
+	    if ( key > 0xFFFF )
+	    {
+		is_special = true;
+		key -= 0xFFFF;
+	    }
+
+	    if (( !is_special && KEY_MIN < key && KEY_MAX > key )
+		||
+		!iswprint( key ) )
+	    {
+		// any other key (e.g. to move the cursor) ends entering the filter
+		entering = false;
+		return false;
+	    }
+
+	    filter += key;
+	    break;
+    }
+
+    return true;
+}
+
+
+
+bool NCTableFilterIndex::marked( const void * key, unsigned mark ) const
+{
+    std::unordered_map<const void *, Entry>::const_iterator it = texts.find( key );
+
+    return it != texts.end() && it->second.mark == mark;
+}
+
+
+
+// The NCTablePad is virtual: the NCursesPad holds just the visible
+// lines, which are drawn on demand via directDraw.
 NCTablePad::NCTablePad( int lines, int cols, const NCWidget & p )
-	: NCPad( lines, cols, p )
+	: NCPad( lines, cols, p, true )
 	, Headpad( 1, 1 )
 	, dirtyHead( false )
 	, dirtyFormat( false )
+	, dirtyLineFormat( false )
 	, ItemStyle( p )
 	, Headline( 0 )
 	, Items( 0 )
+	, changedLines( 0 )
 	, citem( 0 )
+	, dirtyFilter( false )
+	, filterPrompt( false )
+	, dirtyHotkeys( true )
+	, lastHotkey( 0 )
+	, lastHotPos( 0 )
 	, sortStrategy ( new NCTableSortDefault )
+	, modelRows( 0 )
+	, modelLine( 0 )
 {
 }
 
@@ -47,6 +587,7 @@ NCTablePad::NCTablePad( int lines, int cols, const NCWidget & p )
 
 NCTablePad::~NCTablePad()
 {
+    cancelSort();
     ClearTable();
 }
 
@@ -60,18 +601,56 @@ void NCTablePad::assertLine( unsigned idx )
 
 
 
+void NCTablePad::dropLine( NCTableLine * item )
+{
+    if ( !item )
+	return;
+
+    item->ClearFormat( ItemStyle );
+    filterIndex.remove( item );
+
+    if ( !changedLines.empty() )
+	changedLines.erase( std::remove( changedLines.begin(), changedLines.end(), item ),
+			    changedLines.end() );
+    delete item;
+}
+
+
+
 void NCTablePad::SetLines( unsigned idx )
 {
     if ( idx == Lines() )
 	return;
 
+    if ( idx == 0 )
+	cancelSort();
+    else
+	waitForSort();
+
+    linePos.clear();
     unsigned olines = Lines();
 
+    if ( idx == 0 )
+    {
+	// dropping all lines: cheaper to reset the format
+	for ( unsigned i = 0; i < Lines(); ++i )
+	{
+	    delete Items[i];
+	}
+
+	changedLines.clear();
+	Items.clear();
+	filterIndex.clear();
+	lineArena.clear();
+	DirtyFormat();
+	return;
+    }
+
     if ( idx < Lines() )
     {
 	for ( unsigned i = idx; i < Lines(); ++i )
 	{
-	    delete Items[i];
+	    dropLine( Items[i] );
 	}
     }
 
@@ -80,23 +659,24 @@ void NCTablePad::SetLines( unsigned idx )
     for ( unsigned i = olines; i < Lines(); ++i )
     {
 	if ( !Items[i] )
-	    Items[i] = new NCTableLine( 0 );
+	    Items[i] = new ( arena() ) NCTableLine( 0 );
     }
 
-    DirtyFormat();
+    DirtyLine();
 }
 
 
 
 void NCTablePad::SetLines( std::vector<NCTableLine*> & nItems )
 {
+    cancelSort();
     SetLines( 0 );
     Items = nItems;
 
     for ( unsigned i = 0; i < Lines(); ++i )
     {
 	if ( !Items[i] )
-	    Items[i] = new NCTableLine( 0 );
+	    Items[i] = new ( arena() ) NCTableLine( 0 );
     }
 
     DirtyFormat();
@@ -106,11 +686,24 @@ void NCTablePad::SetLines( std::vector<NCTableLine*> & nItems )
 
 void NCTablePad::AddLine( unsigned idx, NCTableLine * item )
 {
+    if ( sorting() && idx < Lines() )
+    {
+	// replace the line at idx, wherever the sort moves it
+	NCTableLine * old = Items[idx];
+	waitForSort();
+	idx = std::find( Items.begin(), Items.end(), old ) - Items.begin();
+    }
+    else
+    {
+	waitForSort();
+    }
+
     assertLine( idx );
-    delete Items[idx];
-    Items[idx] = item ? item : new NCTableLine( 0 );
+    linePos.clear();
+    dropLine( Items[idx] );
+    Items[idx] = item ? item : new ( arena() ) NCTableLine( 0 );
 
-    DirtyFormat();
+    DirtyLine( Items[idx] );
 }
 
 
@@ -119,8 +712,10 @@ void NCTablePad::DelLine( unsigned idx )
 {
     if ( idx < Lines() )
     {
-	Items[idx]->ClearLine();
-	DirtyFormat();
+	NCTableLine * line = Items[idx];
+	waitForSort();
+	line->ClearLine();
+	DirtyLine( line );
     }
 }
 
@@ -140,8 +735,10 @@ NCTableLine * NCTablePad::ModifyLine( unsigned idx )
 {
     if ( idx < Lines() )
     {
-	DirtyFormat();
-	return Items[idx];
+	NCTableLine * line = Items[idx];
+	waitForSort();
+	DirtyLine( line );
+	return line;
     }
 
     return 0;
@@ -149,6 +746,16 @@ NCTableLine * NCTablePad::ModifyLine( unsigned idx )
 
 
 
+void NCTablePad::DirtyLine( NCTableLine * item )
+{
+    dirty = dirtyLineFormat = true;
+
+    if ( item && ( changedLines.empty() || changedLines.back() != item ) )
+	changedLines.push_back( item );
+}
+
+
+
 bool NCTablePad::SetHeadline( const std::vector<NCstring> & head )
 {
     bool hascontent = ItemStyle.SetStyleFrom( head );
@@ -180,16 +787,251 @@ wsze NCTablePad::UpdateFormat()
     yuiDebug() << std::endl;
     dirty = true;
     dirtyFormat = false;
+    dirtyHotkeys = true;
+    dirtyLineFormat = false;
+    changedLines.clear();
     ItemStyle.ResetToMinCols();
 
+    if ( model )
+    {
+	// the model is not measured, it just gives hints
+	modelRows = model->rowCount();
+
+	for ( unsigned c = 0; c < Cols(); ++c )
+	    ItemStyle.MinColWidth( c, model->widthHint( c ) );
+
+	if ( modelLine.Cols() != Cols() )
+	{
+	    modelCells.clear();
+	    modelLine.ClearLine();
+
+	    for ( unsigned c = 0; c < Cols(); ++c )
+		modelLine.Append( new NCTableCol() );
+	}
+
+	resize( wsze( modelRows, ItemStyle.TableWidth() ) );
+
+	return wsze( modelRows, ItemStyle.TableWidth() );
+    }
+
     for ( unsigned l = 0; l < Lines(); ++l )
     {
 	Items[l]->UpdateFormat( ItemStyle );
     }
 
-    resize( wsze( Lines(), ItemStyle.TableWidth() ) );
+    // the texts may have changed (e.g. recoded): index them on demand
+    filterIndex.clear();
+
+    if ( filtered() )
+	applyFilter();
+
+    resize( wsze( visibleLines(), ItemStyle.TableWidth() ) );
+
+    return wsze( visibleLines(), ItemStyle.TableWidth() );
+}
+
+
+
+// Measure just the lines changed since the last format update. The
+// column widths are adjusted via the width statistics in ItemStyle.
+wsze NCTablePad::UpdateLineFormat()
+{
+    dirty = true;
+    dirtyLineFormat = false;
+    dirtyHotkeys = true;
+
+    for ( unsigned i = 0; i < changedLines.size(); ++i )
+    {
+	changedLines[i]->ClearFormat( ItemStyle );
+	changedLines[i]->UpdateFormat( ItemStyle );
+
+	if ( !filterIndex.empty() )
+	    filterIndex.update( changedLines[i] );
+    }
+
+    changedLines.clear();
+
+    // lines were added, removed or changed
+    if ( filtered() )
+	applyFilter();
 
-    return wsze( Lines(), ItemStyle.TableWidth() );
+    resize( wsze( visibleLines(), ItemStyle.TableWidth() ) );
+
+    return wsze( visibleLines(), ItemStyle.TableWidth() );
+}
+
+
+
+void NCTablePad::assertFormat()
+{
+    if ( dirtyFormat )
+	UpdateFormat();
+    else if ( dirtyLineFormat )
+	UpdateLineFormat();
+    else if ( dirtyFilter )
+    {
+	applyFilter();
+	resize( wsze( visibleLines(), ItemStyle.TableWidth() ) );
+    }
+}
+
+
+
+void NCTablePad::applyFilter()
+{
+    dirty = true;
+    dirtyFilter = false;
+    dirtyHotkeys = true;
+
+    // try to keep the cursor on the current line
+    int current = CurrentIndex();
+
+    if ( !filtered() )
+    {
+	visItems.clear();
+    }
+    else
+    {
+	if ( filterIndex.empty() || filterIndex.needsRebuild() )
+	{
+	    filterIndex.clear();
+
+	    for ( unsigned l = 0; l < Lines(); ++l )
+		filterIndex.update( Items[l] );
+	}
+
+	// cleared whenever Items change their order
+	if ( linePos.size() != Lines() )
+	{
+	    linePos.clear();
+
+	    for ( unsigned l = 0; l < Lines(); ++l )
+		linePos[ Items[l] ] = l;
+	}
+
+	// just the lines listed for the filter, not all of them
+	std::vector<const void *> hits;
+	filterIndex.mark( filterText, &hits );
+
+	visItems.clear();
+
+	for ( unsigned i = 0; i < hits.size(); ++i )
+	{
+	    std::unordered_map<const void *, unsigned>::const_iterator it = linePos.find( hits[i] );
+
+	    if ( it != linePos.end() )
+		visItems.push_back( it->second );
+	}
+
+	std::sort( visItems.begin(), visItems.end() );
+    }
+
+    citem.L = 0;
+
+    if ( current >= 0 )
+    {
+	if ( !filtered() )
+	{
+	    citem.L = current;
+	}
+	else
+	{
+	    std::vector<unsigned>::const_iterator it
+		= std::lower_bound( visItems.begin(), visItems.end(), ( unsigned )current );
+
+	    if ( it != visItems.end() && *it == ( unsigned )current )
+		citem.L = it - visItems.begin();
+	}
+    }
+
+    yuiDebug() << "Filter shows " << visibleLines() << " of " << Lines() << " lines" << std::endl;
+}
+
+
+
+void NCTablePad::setFilter( const std::wstring & filter )
+{
+    std::wstring nfilter( filter );
+
+    for ( std::wstring::iterator it = nfilter.begin(); it != nfilter.end(); ++it )
+	*it = std::towlower( *it );
+
+    if ( nfilter == filterText || model )
+	return;
+
+    assertFormat();
+
+    // a running sort does not change Items until it is done, so it may go on
+    filterText = nfilter;
+    applyFilter();
+
+    resize( wsze( visibleLines(), ItemStyle.TableWidth() ) );
+    update();
+}
+
+
+
+void NCTablePad::setFilterPrompt( bool prompt )
+{
+    if ( prompt == filterPrompt )
+	return;
+
+    filterPrompt = prompt;
+    DrawHead();
+}
+
+
+
+const NCTableLine * NCTablePad::GetCurrentLine() const
+{
+    if ( model )
+	return 0;
+
+    int idx = CurrentIndex();
+
+    return idx >= 0 ? Items[idx] : 0;
+}
+
+
+
+int NCTablePad::CurrentIndex() const
+{
+    unsigned row = citem.L;
+
+    if ( row >= visibleLines() )
+	return -1;
+
+    if ( model )
+	return row;
+
+    unsigned idx = filtered() ? visItems[row] : row;
+
+    // visItems may be outdated until the next format update
+    return idx < Lines() ? ( int )idx : -1;
+}
+
+
+
+void NCTablePad::ScrlToIndex( int idx )
+{
+    if ( filtered() && idx >= 0 )
+    {
+	assertFormat();
+
+	std::vector<unsigned>::const_iterator it
+	    = std::lower_bound( visItems.begin(), visItems.end(), ( unsigned )idx );
+
+	if ( it != visItems.end() && *it == ( unsigned )idx )
+	{
+	    ScrlLine( it - visItems.begin() );
+	    return;
+	}
+
+	// the line is hidden: show all lines
+	setFilter( std::wstring() );
+    }
+
+    ScrlLine( idx );
 }
 
 
@@ -204,8 +1046,7 @@ int NCTablePad::DoRedraw()
 
     yuiDebug() << "dirtyFormat " << dirtyFormat << std::endl;
 
-    if ( dirtyFormat )
-	UpdateFormat();
+    assertFormat();
 
     bkgdset( ItemStyle.getBG() );
 
@@ -215,58 +1056,160 @@ int NCTablePad::DoRedraw()
 
     if ( ! pageing() )
     {
-    for ( unsigned l = 0; l < Lines(); ++l )
+    for ( unsigned l = 0; l < visibleLines(); ++l )
     {
-	Items[l]->DrawAt( *this, wrect( wpos( l, 0 ), lSze ),
-			  ItemStyle, (( unsigned )citem.L == l ) );
+	drawLine( *this, wrect( wpos( l, 0 ), lSze ), l, (( unsigned )citem.L == l ) );
     }
     }
     // else: item drawing requested via directDraw
 
+    DrawHead();
+
+    dirty = false;
+
+    return update();
+}
+
+
+
+void NCTablePad::DrawHead()
+{
     if ( Headpad.width() != width() )
 	Headpad.resize( 1, width() );
 
     Headpad.clear();
 
-    ItemStyle.Headline().DrawAt( Headpad, wrect( wpos( 0, 0 ), lSze ),
+    ItemStyle.Headline().DrawAt( Headpad, wrect( wpos( 0, 0 ), wsze( 1, width() ) ),
 				 ItemStyle, false );
 
-    SendHead();
+    std::wstring hint;
 
-    dirty = false;
+    if ( filtered() || filterPrompt )
+    {
+	hint += L" /" + filterText + ( filterPrompt ? L"_" : L"" );
+	hint += NCstring( form( " (%u/%u) ", visibleLines(), Lines() ) ).str();
+    }
 
-    return update();
+    if ( sorting() )
+	hint += NCstring( form( " %s %d%% ", _( "sorting" ).c_str(), sortJob->progress() ) ).str();
+
+    if ( !hint.empty() )
+    {
+	// show the hint right aligned in the visible part of the headline
+	int hwidth = NCwidth::columns( hint, NCurses::tabsize() );
+	int at = srect.Pos.C + srect.Sze.W - hwidth;
+
+	Headpad.bkgdset( ItemStyle.getBG( NCTableLine::S_HEADLINE ) | A_REVERSE );
+	Headpad.addwstr( 0, std::max( 0, at ), hint.c_str() );
+    }
+
+    SendHead();
 }
 
 
 
 void NCTablePad::directDraw( NCursesWindow & w, const wrect at, unsigned lineno )
 {
-    if ( lineno < Lines() )
-        Items[lineno]->DrawAt( w, at, ItemStyle, ((unsigned)citem.L == lineno) );
+    if ( lineno < visibleLines() )
+        drawLine( w, at, lineno, ((unsigned)citem.L == lineno) );
     else
-        yuiWarning() << "Illegal Lineno " << lineno << " (" << Lines() << ")" << std::endl;
+        yuiWarning() << "Illegal Lineno " << lineno << " (" << visibleLines() << ")" << std::endl;
+}
+
+
+
+void NCTablePad::drawLine( NCursesWindow & w, const wrect at, unsigned row, bool active )
+{
+    if ( model )
+    {
+	std::unordered_map<unsigned, std::vector<NClabel> >::iterator it = modelCells.find( row );
+
+	if ( it == modelCells.end() )
+	{
+	    // recode a row once while it stays on (or near) the screen
+	    if ( modelCells.size() > 4 * ( unsigned )srect.Sze.H )
+		modelCells.clear();
+
+	    it = modelCells.insert( std::make_pair( row, std::vector<NClabel>() ) ).first;
+	    it->second.reserve( modelLine.Cols() );
+
+	    for ( unsigned c = 0; c < modelLine.Cols(); ++c )
+		it->second.push_back( NClabel( NCstring( model->cellText( row, c ) ) ) );
+	}
+
+	// fill the cells of modelLine from the model
+	for ( unsigned c = 0; c < modelLine.Cols(); ++c )
+	    modelLine.GetCol( c )->SetLabel( it->second[c] );
+
+	modelLine.DrawAt( w, at, ItemStyle, active );
+    }
+    else
+    {
+	visibleLine( row )->DrawAt( w, at, ItemStyle, active );
+    }
+}
+
+
+
+void NCTablePad::setModel( NCTableModel * newModel )
+{
+    cancelSort();
+    ClearTable();
+
+    filterText.clear();
+    visItems.clear();
+    filterPrompt = false;
+
+    model.reset( newModel );
+    modelRows = 0;
+    modelLine.ClearLine();
+    modelCells.clear();
+    citem.L = 0;
+
+    DirtyFormat();
+    update();
+}
+
+
+
+void NCTablePad::modelChanged()
+{
+    if ( !model )
+	return;
+
+    modelCells.clear();
+    DirtyFormat();
+    update();
 }
 
 
 
 int NCTablePad::setpos( const wpos & newpos )
 {
-    if ( !Lines() )
+    if ( held )
     {
-	if ( dirty || dirtyFormat )
+	// in a batch (see NCPadWidget::beginUpdate): just remember the
+	// line, the lines are measured and drawn once the batch ends
+	citem.L = newpos.L < 0 ? 0 : newpos.L;
+	srect.Pos.C = newpos.C;
+	dirty = true;
+	return OK;
+    }
+
+    assertFormat();
+
+    if ( !visibleLines() )
+    {
+	if ( dirty )
 	    return DoRedraw();
 
 	return OK;
     }
 
-    yuiDebug() << newpos << " : l " << Lines() << " : cl " << citem.L
+    yuiDebug() << newpos << " : l " << visibleLines() << " : cl " << citem.L
 
     << " : d " << dirty << " : df " << dirtyFormat << std::endl;
 
-    if ( dirtyFormat )
-	UpdateFormat();
-
     // save old values
     int oitem = citem.L;
 
@@ -275,8 +1218,8 @@ int NCTablePad::setpos( const wpos & newpos )
     // calc new values
     citem.L = newpos.L < 0 ? 0 : newpos.L;
 
-    if (( unsigned )citem.L >= Lines() )
-	citem.L = Lines() - 1;
+    if (( unsigned )citem.L >= visibleLines() )
+	citem.L = visibleLines() - 1;
 
     srect.Pos = wpos( citem.L - ( drect.Sze.H - 1 ) / 2, newpos.C ).between( 0, maxspos );
 
@@ -290,13 +1233,10 @@ int NCTablePad::setpos( const wpos & newpos )
     // adjust only
     if ( citem.L != oitem )
     {
-	Items[oitem]->DrawAt( *this, wrect( wpos( oitem, 0 ), wsze( 1, width() ) ),
-			      ItemStyle, false );
+	drawLine( *this, wrect( wpos( oitem, 0 ), wsze( 1, width() ) ), oitem, false );
     }
 
-    Items[citem.L]->DrawAt( *this, wrect( wpos( citem.L, 0 ), wsze( 1, width() ) ),
-
-			    ItemStyle, true );
+    drawLine( *this, wrect( wpos( citem.L, 0 ), wsze( 1, width() ) ), citem.L, true );
     }
     // else: item drawing requested via directDraw
 
@@ -315,30 +1255,68 @@ void NCTablePad::updateScrollHint()
 
 
 
+// Collect the visible rows by hotkey. Done on demand after the lines,
+// their order or the filter changed.
+void NCTablePad::assertHotkeys()
+{
+    if ( !dirtyHotkeys )
+	return;
+
+    dirtyHotkeys = false;
+    hotRows.assign( UCHAR_MAX + 1, std::vector<unsigned>() );
+
+    unsigned hcol = HotCol();
+
+    for ( unsigned l = 0; l < visibleLines(); ++l )
+    {
+	const NCTableCol * col = visibleLine( l )->GetCol( hcol );
+
+	if ( col && col->hasHotkey() )
+	    hotRows[ tolower( col->hotkey() ) ].push_back( l );
+    }
+}
+
+
+
 bool NCTablePad::setItemByKey( int key )
 {
-    if ( HotCol() >= Cols() )
+    if ( HotCol() >= Cols() || model )
 	return false;
 
     if ( key < 0 || UCHAR_MAX < key )
 	return false;
 
-    unsigned hcol = HotCol();
+    assertFormat();
+    assertHotkeys();
 
     unsigned hkey = tolower( key );
+    const std::vector<unsigned> & rows( hotRows[hkey] );
 
-    for ( unsigned l = 0; l < Lines(); ++l )
+    if ( rows.empty() )
+	return false;
+
+    unsigned pos = 0;
+
+    if ( hkey == lastHotkey && lastHotPos < rows.size() && rows[lastHotPos] == ( unsigned )citem.L )
     {
-	if ( Items[l]->GetCol( hcol )->hasHotkey()
-	     &&
-	     ( unsigned )tolower( Items[l]->GetCol( hcol )->hotkey() ) == hkey )
-	{
-	    ScrlLine( l );
-	    return true;
-	}
+	// pressed again: next one
+	pos = ( lastHotPos + 1 ) % rows.size();
     }
+    else
+    {
+	// the first one after the cursor
+	std::vector<unsigned>::const_iterator it
+	    = std::upper_bound( rows.begin(), rows.end(), ( unsigned )citem.L );
 
-    return false;
+	if ( it != rows.end() )
+	    pos = it - rows.begin();
+    }
+
+    lastHotkey = hkey;
+    lastHotPos = pos;
+    ScrlLine( rows[pos] );
+
+    return true;
 }
 
 //
@@ -348,25 +1326,98 @@ bool NCTablePad::setItemByKey( int key )
 //
 void NCTablePad::setOrder( int col, bool do_reverse )
 {
-    if ( col < 0 )
+    if ( col < 0 || model )
 	return;
 
-    if ( sortStrategy->getColumn() == col && do_reverse )
+    // a canceled sort did not apply its order, so sort again
+    bool wasSorting = cancelSort();
+
+    // the strategy stays canceled, until a new sort starts
+    sortStrategy->cancel( false );
+
+    if ( !wasSorting && sortStrategy->getColumn() == col && do_reverse )
     {
 	std::reverse( Items.begin(), Items.end() );
     }
     else
     {
 	sortStrategy->setColumn( col );
+
+	// recode the labels here, the sort may run in worker threads
+	sortStrategy->prepareSort( Items.begin(), Items.end(), col );
+
+	if ( Lines() >= BACKGROUND_SORT_LINES && sortStrategy->canSortInBackground() )
+	{
+	    yuiDebug() << "Sorting " << Lines() << " lines in the background" << std::endl;
+	    sortJob.reset( new NCTableSortJob( *this, *sortStrategy, Items, col ) );
+	    DrawHead();
+	    return;
+	}
+
 	sortStrategy->sort( Items.begin(), Items.end(), col );
     }
 
+    // the filter and hotkey rows refer to the old order
+    linePos.clear();
     dirty = true;
+    dirtyFilter = filtered();
+    dirtyHotkeys = true;
     update();
 }
 
 
 
+bool NCTablePad::sorting() const
+{
+    return sortJob && sortJob->running();
+}
+
+
+
+// Cancel a sort running in the background (if any) and wait for the
+// worker to finish. Returns whether a sort was canceled.
+bool NCTablePad::cancelSort()
+{
+    if ( !sorting() )
+	return false;
+
+    yuiDebug() << "Cancel background sort" << std::endl;
+    sortJob->cancel();
+    DrawHead();
+    return true;
+}
+
+
+
+// Wait for a sort running in the background (if any) and apply its
+// order, e.g. before the lines change. Unlike cancelSort this keeps the
+// order the user asked for.
+void NCTablePad::waitForSort()
+{
+    if ( !sorting() )
+	return;
+
+    yuiDebug() << "Wait for background sort" << std::endl;
+    sortJob->finish();
+    DrawHead();
+}
+
+
+
+// Apply the result of the background sort (called via NCTableSortJob).
+void NCTablePad::finishSort( std::vector<NCTableLine*> & sorted )
+{
+    Items.swap( sorted );
+    std::vector<NCTableLine*>().swap( sorted );
+    linePos.clear();
+
+    dirty = true;
+    dirtyFilter = filtered();
+    dirtyHotkeys = true;
+}
+
+
+
 bool NCTablePad::handleInput( wint_t key )
 {
     return NCPad::handleInput( key );
@@ -374,6 +1425,9 @@ bool NCTablePad::handleInput( wint_t key )
 
 void NCTablePad::stripHotkeys()
 {
+    // the sort may read the labels
+    waitForSort();
+
     for ( unsigned i = 0; i < Lines(); ++i )
     {
 	if ( Items[i] )
@@ -381,6 +1435,8 @@ void NCTablePad::stripHotkeys()
 	    Items[i]->stripHotkeys();
 	}
     }
+
+    dirtyHotkeys = true;
 }
 
 
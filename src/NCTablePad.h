@@ -28,19 +28,26 @@
 #include <iosfwd>
 #include <vector>
 #include <memory>		// unique_ptr
+#include <cwchar>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
 
 #include "NCTableItem.h"
+#include "NCTableModel.h"
 #include "NCPad.h"
 #include "NCstring.h"
 
 class NCTableLine;
 class NCTableCol;
+class NCTableSortJob;
 
 
 class NCTableSortStrategyBase
 {
 public:
-    NCTableSortStrategyBase( ) { _uiColumn = -1; }
+    NCTableSortStrategyBase( ) : _canceled( false ), _progress( 0 ) { _uiColumn = -1; }
 
     virtual ~NCTableSortStrategyBase() {}
 
@@ -52,61 +59,154 @@ public:
     int getColumn ()			{ return _uiColumn; }
     void setColumn ( int column)	{ _uiColumn = column; }
 
+    /**
+     * Whether \ref sort may run in a worker thread. Such a sort must just
+     * read the lines, check \ref canceled regularly and leave the items
+     * untouched if it was canceled.
+     */
+    virtual bool canSortInBackground() const { return false; }
+
+    /**
+     * Called in the UI thread before every \ref sort, which may run in
+     * worker threads. Recodes the labels of \a uiColumn (see
+     * NCTableCol::assertLabel), so the workers just read them.
+     */
+    virtual void prepareSort( std::vector<NCTableLine *>::iterator itemsBegin,
+			      std::vector<NCTableLine *>::iterator itemsEnd,
+			      int uiColumn );
+
+    void cancel( bool cancel = true )	{ _canceled = cancel; }
+    bool canceled() const		{ return _canceled; }
+
+    /** Progress of a running sort in percent. */
+    int  progress() const		{ return _progress; }
+
+protected:
+    void setProgress( int progress )	{ _progress = progress; }
+
 private:
     int	_uiColumn;
+    std::atomic<bool> _canceled;
+    std::atomic<int>  _progress;
 
 };
 
 class NCTableSortDefault : public NCTableSortStrategyBase {
 public:
+    /**
+     * Stable sort by the cells in \a uiColumn. Cells that are numbers in
+     * both lines are compared numerically, all others using the collating
+     * information of the current locale. Lines equal in \a uiColumn are
+     * compared by the secondary columns (see \ref setSecondaryColumns).
+     *
+     * The sort keys are computed just once per line before sorting. Large
+     * tables are sorted by a parallel merge sort.
+     */
     virtual void sort (
 		       std::vector<NCTableLine *>::iterator itemsBegin,
 		       std::vector<NCTableLine *>::iterator itemsEnd,
 		       int  uiColumn
-		       )
-        {
-	    std::sort ( itemsBegin, itemsEnd, Compare(uiColumn) );
-        }
+		       );
+
+    virtual bool canSortInBackground() const { return true; }
+
+    /** Recodes the secondary columns, too. */
+    virtual void prepareSort( std::vector<NCTableLine *>::iterator itemsBegin,
+			      std::vector<NCTableLine *>::iterator itemsEnd,
+			      int uiColumn );
+
+    /**
+     * Columns to compare if lines are equal in the sort column.
+     */
+    void setSecondaryColumns( const std::vector<int> & columns ) { _secondary = columns; }
+
+    const std::vector<int> & secondaryColumns() const { return _secondary; }
 
 private:
+
+    /**
+     * The sort key of a single cell.
+     */
+    struct SortKey
+    {
+	bool   isNumber;
+	long   number;
+	size_t collKey;		// offset of the wcsxfrm key in the key buffer
+    };
+
+    static SortKey makeKey( std::vector<wchar_t> & collKeys,
+			    const NCTableLine * line,
+			    int uiCol );
+
     class Compare
     {
     public:
-	Compare ( int uiCol)
-	    : _uiCol ( uiCol )
+	// The collation keys of the lines in [n*chunk, (n+1)*chunk)
+	// are stored in collKeys[n].
+	Compare ( const std::vector<SortKey> & keys,
+		  const std::vector< std::vector<wchar_t> > & collKeys,
+		  unsigned chunk,
+		  unsigned cols )
+	    : _keys( keys )
+	    , _collKeys( collKeys )
+	    , _chunk( chunk )
+	    , _cols( cols )
 	    {}
 
-	bool operator() ( NCTableLine * first,
-			  NCTableLine * second
-			  ) const
+	// compare lines by their index in the key array
+	bool operator() ( unsigned first, unsigned second ) const
 	    {
-                std::wstring w1 = first->GetCol( _uiCol )->Label().getText().begin()->str();
-                std::wstring w2 = second->GetCol( _uiCol )->Label().getText().begin()->str();
-		wchar_t *endptr1 = 0;
-		wchar_t *endptr2 = 0;
+		const SortKey * k1 = &_keys[ first * _cols ];
+		const SortKey * k2 = &_keys[ second * _cols ];
+		const wchar_t * c1 = &_collKeys[ first / _chunk ][0];
+		const wchar_t * c2 = &_collKeys[ second / _chunk ][0];
+
+		for ( unsigned c = 0; c < _cols; ++c )
+		{
+		    int result = compare( k1[c], c1, k2[c], c2 );
+
+		    if ( result )
+			return result < 0;
+		}
 
-		long int number1 = std::wcstol( w1.c_str(), &endptr1, 10 );
-		long int number2 = std::wcstol( w2.c_str(), &endptr2, 10 );
+		return false;
+	    }
 
-		if ( *endptr1 == L'\0' && *endptr2 == L'\0' )
+    private:
+	int compare( const SortKey & k1, const wchar_t * c1,
+		     const SortKey & k2, const wchar_t * c2 ) const
+	    {
+		if ( k1.isNumber && k2.isNumber )
 		{
 		    // both are numbers
-		    return number1 < number2;
+		    return k1.number < k2.number ? -1 : ( k2.number < k1.number ? 1 : 0 );
 		}
-		else
-		{
-		    // compare strings using collating information
-		    int result = std::wcscoll ( w1.c_str(), w2.c_str() );
 
-		    return result < 0;
-		}
+		// compare strings using collating information
+		return std::wcscmp( c1 + k1.collKey, c2 + k2.collKey );
 	    }
 
-    private:
-	int _uiCol;
+	const std::vector<SortKey> & _keys;
+	const std::vector< std::vector<wchar_t> > & _collKeys;
+	unsigned _chunk;
+	unsigned _cols;
     };
 
-
+    void sortChunk( std::vector<NCTableLine *>::iterator itemsBegin,
+		    const std::vector<int> & cols,
+		    std::vector<SortKey> & keys,
+		    std::vector< std::vector<wchar_t> > & collKeys,
+		    std::vector<unsigned> & order,
+		    unsigned chunk,
+		    unsigned n );
+
+    void mergeChunks( const Compare & compare,
+		      std::vector<unsigned> & order,
+		      unsigned first,
+		      unsigned width,
+		      unsigned step );
+
+    std::vector<int> _secondary;
 };
 
 class NCTableTag : public NCTableCol
@@ -152,6 +252,105 @@ public:
     YItem *origItem() { return yitem; }
 };
 
+/**
+ * N-gram index over the (lower case) text of table lines, used to
+ * filter the lines of a NCTablePad. All single chars, pairs and
+ * trigrams of a text are posted, so even a short pattern needs no
+ * scan of all texts. Changed lines are simply indexed again; stale
+ * postings of changed or removed lines are sorted out by verifying
+ * the candidates against the current text.
+ */
+class NCTableFilterIndex
+{
+public:
+
+    NCTableFilterIndex() : generation( 0 ), stale( 0 ) {}
+
+    bool empty() const { return texts.empty(); }
+
+    size_t size() const { return texts.size(); }
+
+    void clear();
+
+    /** (Re)index the text of \a line. */
+    void update( const NCTableLine * line );
+
+    /**
+     * (Re)index \a text (lower case) for \a key, e.g. an item that has
+     * no line (yet).
+     */
+    void update( const void * key, std::wstring text );
+
+    /** Drop \a key (a line) from the index. */
+    void remove( const void * key );
+
+    /** The (lower case) text indexed for \a key, or \c 0. */
+    const std::wstring * text( const void * key ) const
+    {
+	std::unordered_map<const void *, Entry>::const_iterator it = texts.find( key );
+	return it != texts.end() ? &it->second.text : 0;
+    }
+
+    /**
+     * Mark all keys whose text contains \a pattern (lower case).
+     * Returns the mark to pass to \ref marked. The keys are added to
+     * \a hits, if given.
+     */
+    unsigned mark( const std::wstring & pattern, std::vector<const void *> * hits = 0 );
+
+    bool marked( const void * key, unsigned mark ) const;
+
+    /** Whether so many postings are stale that rebuilding pays off. */
+    bool needsRebuild() const { return stale > texts.size(); }
+
+    /** The lower case text of all cells of \a line. */
+    static std::wstring lineText( const NCTableLine * line );
+
+    /**
+     * Type-to-filter key handling shared by the widgets: '/' starts
+     * entering a filter (\a entering), every key typed edits \a filter.
+     * Return keeps the filter, Esc drops it; both end entering it.
+     * Returns false if \a key is no filter input; any key not handled
+     * (e.g. to move the cursor) ends entering the filter, too.
+     */
+    static bool editFilter( wint_t key, bool & entering, std::wstring & filter );
+
+private:
+
+    typedef uint64_t Trigram;
+
+    /** The key of the \a n (1 to 3) chars at \a s. */
+    static Trigram trigram( const wchar_t * s, unsigned n = 3 )
+    {
+	// a trigram uses 63 bits, the top bit tags the shorter ones
+	switch ( n )
+	{
+	    case 1:
+		return ( ( Trigram )1 << 63 ) | ( Trigram )( s[0] & 0x1fffff );
+
+	    case 2:
+		return ( ( Trigram )1 << 63 ) | ( ( Trigram )1 << 42 )
+		     | ( ( Trigram )( s[0] & 0x1fffff ) << 21 )
+		     |   ( Trigram )( s[1] & 0x1fffff );
+	}
+
+	return ( ( Trigram )( s[0] & 0x1fffff ) << 42 )
+	     | ( ( Trigram )( s[1] & 0x1fffff ) << 21 )
+	     |   ( Trigram )( s[2] & 0x1fffff );
+    }
+
+    struct Entry
+    {
+	std::wstring text;
+	unsigned     mark;
+    };
+
+    std::unordered_map<const void *, Entry> texts;
+    std::unordered_map<Trigram, std::vector<const void *> > postings;
+    unsigned generation;
+    size_t   stale;
+};
+
 class NCTablePad : public NCPad
 {
 
@@ -162,24 +361,85 @@ class NCTablePad : public NCPad
 
 private:
 
+    NCTableArena	lineArena;	// outlives the lines
+
     NCursesPad	Headpad;
     bool	dirtyHead;
     bool	dirtyFormat;
+    bool	dirtyLineFormat;
 
     NCTableStyle	 ItemStyle;
     NCTableLine		 Headline;
     std::vector<NCTableLine*> Items;
+    std::vector<NCTableLine*> changedLines;
     wpos		 citem;
 
+    NCTableFilterIndex	 filterIndex;
+    std::wstring	 filterText;
+    std::vector<unsigned> visItems;	// indices of the matching Items
+    std::unordered_map<const void *, unsigned> linePos;	// index of a line in Items (if filled)
+    bool		 dirtyFilter;
+    bool		 filterPrompt;
+
+    std::vector< std::vector<unsigned> > hotRows; // visible rows by (lower case) hotkey
+    bool		 dirtyHotkeys;
+    unsigned		 lastHotkey;	// to cycle through hotRows on
+    unsigned		 lastHotPos;	// repeated presses of a key
+
     std::unique_ptr<NCTableSortStrategyBase> sortStrategy;
 
+    std::unique_ptr<NCTableModel> model;
+    unsigned		 modelRows;
+    NCTableLine		 modelLine;	// to draw a row of the model
+
+    /** The recoded cells of the model rows drawn lately (see drawLine). */
+    std::unordered_map<unsigned, std::vector<NClabel> > modelCells;
+
+    friend class NCTableSortJob;
+    std::unique_ptr<NCTableSortJob> sortJob;
+
+    bool cancelSort();
+    void waitForSort();
+    void finishSort( std::vector<NCTableLine*> & sorted );
+
     void assertLine( unsigned idx );
+    void assertFormat();
+    void dropLine( NCTableLine * item );
+
+    /** Compute visItems for filterText from the lines the filterIndex
+     * lists for it.
+     */
+    void applyFilter();
+
+    void assertHotkeys();
+
+    /** The number of lines shown, i.e. matching the filter. */
+    unsigned visibleLines() const
+    {
+	if ( model )
+	    return modelRows;
+
+	return filtered() ? visItems.size() : Items.size();
+    }
+
+    /** The line shown in \a row. */
+    NCTableLine * visibleLine( unsigned row ) const
+    {
+	return filtered() ? Items[visItems[row]] : Items[row];
+    }
 
 protected:
 
+    /** Request to measure all lines again. */
     void	 DirtyFormat() { dirty = dirtyFormat = true; }
 
+    /** Request to measure just \a item again (or just to adjust the
+     * pad size to the number of lines if \a item is \c 0).
+     */
+    void	 DirtyLine( NCTableLine * item = 0 );
+
     virtual wsze UpdateFormat();
+    wsze	 UpdateLineFormat();
 
     virtual int  dirtyPad() { return setpos( CurPos() ); }
 
@@ -187,8 +447,14 @@ protected:
     virtual int  DoRedraw();
     virtual void updateScrollHint();
 
+    /** Draw the headline (and the progress of a background sort). */
+    void	 DrawHead();
+
     virtual void directDraw( NCursesWindow & w, const wrect at, unsigned lineno );
 
+    /** Draw the line (or row of the model) shown in \a row. */
+    void	 drawLine( NCursesWindow & w, const wrect at, unsigned row, bool active );
+
 public:
 
     NCTablePad( int lines, int cols, const NCWidget & p );
@@ -201,16 +467,67 @@ public:
     virtual wpos CurPos() const;
     virtual bool handleInput( wint_t key );
 
+    /**
+     * Move the cursor to the next line after the cursor having hotkey
+     * \a key in the HotCol. Repeated presses cycle through these lines.
+     */
     bool setItemByKey( int key );
 
     wsze tableSize()
     {
-	return dirtyFormat ? UpdateFormat()
-	       : wsze( Lines(), ItemStyle.TableWidth() );
+	assertFormat();
+	return wsze( model ? modelRows : Lines(), ItemStyle.TableWidth() );
     }
 
+    /**
+     * Show the rows of \a model (dyn. allocated, owned by the pad)
+     * instead of the lines. The lines are cleared; sorting, filtering
+     * and hotkeys are up to the model. \c 0 returns to showing lines.
+     */
+    void setModel( NCTableModel * newModel );
+
+    bool hasModel() const { return model.get() != 0; }
+
+    /** Show the model again after its rows changed. */
+    void modelChanged();
+
+    /**
+     * Sort the table by \a column. Large tables are sorted in a worker
+     * thread if the sort strategy supports this; the new order is applied
+     * when the sort is done. Any change of the table, and any newer sort,
+     * cancels a running sort.
+     */
     void setOrder( int column, bool do_reverse = false );
 
+    /** Whether a sort is running in the background. */
+    bool sorting() const;
+
+    /**
+     * Show just the lines containing \a filter (case insensitive) in
+     * any cell. An empty \a filter shows all lines.
+     */
+    void setFilter( const std::wstring & filter );
+
+    const std::wstring & filter() const { return filterText; }
+
+    bool filtered() const { return !filterText.empty(); }
+
+    /** Show the filter in the headline even if it is empty (while the
+     * user is typing it).
+     */
+    void setFilterPrompt( bool prompt );
+
+    /** The line at the cursor (or \c 0). */
+    const NCTableLine * GetCurrentLine() const;
+
+    /** The index of the line at the cursor (or -1). */
+    int CurrentIndex() const;
+
+    /** Move the cursor to the line at \a idx. If the line is hidden by
+     * the filter, the filter is cleared.
+     */
+    void ScrlToIndex( int idx );
+
 public:
 
     bool SetHeadline( const std::vector<NCstring> & head );
@@ -234,8 +551,14 @@ public:
     void SetHotCol( const int hcol )
     {
 	ItemStyle.SetHotCol( hcol );
+	dirtyHotkeys = true;
     }
 
+    /** The arena to allocate the lines and columns of this pad from,
+     * i.e. use \c new(pad->arena()) to create them.
+     */
+    NCTableArena * arena() { return &lineArena; }
+
     unsigned Cols()  const { return ItemStyle.Cols(); }
 
     unsigned Lines() const { return Items.size(); }
@@ -250,7 +573,7 @@ public:
 
     void Append( std::vector<NCTableCol*> & nItems, int index = -1 )
     {
-	AddLine( Lines(), new NCTableLine( nItems, index ) );
+	AddLine( Lines(), new ( arena() ) NCTableLine( nItems, index ) );
     }
 
     void AddLine( unsigned idx, NCTableLine * item );
@@ -264,7 +587,10 @@ public:
     void setSortStrategy ( NCTableSortStrategyBase * newSortStrategy ) // dyn. allocated
     {
         if ( newSortStrategy != 0 )
+        {
+            cancelSort();
             sortStrategy.reset ( newSortStrategy );
+        }
     }
 };
 
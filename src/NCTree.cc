@@ -25,233 +25,21 @@
 #define	 YUILogComponent "ncurses"
 #include <yui/YUILog.h>
 #include "NCTree.h"
+#include "stdutil.h"
+#include "NCwidth.h"
 
 #include <yui/TreeItem.h>
 #include <yui/YSelectionWidget.h>
 
-
-class NCTreeLine : public NCTableLine
-{
-
-private:
-
-    YTreeItem *		yitem;
-    const unsigned	level;
-
-    NCTreeLine * parent;
-    NCTreeLine * nsibling;
-    NCTreeLine * fchild;
-
-    mutable chtype * prefix;
-    bool multiSel;
-    unsigned prefixLen() const { return level + 3; }
-
-public:
-
-    NCTreeLine( NCTreeLine * p, YTreeItem * item, bool multiSelection )
-	    : NCTableLine( 0 )
-	    , yitem( item )
-	    , level( p ? p->level + 1 : 0 )
-	    , parent( p )
-	    , nsibling( 0 )
-	    , fchild( 0 )
-	    , prefix( 0 )
-	    , multiSel( multiSelection )
-    {
-	if ( parent )
-	{
-	    if ( parent->fchild )
-	    {
-		NCTreeLine * s = parent->fchild;
-
-		for ( ; s->nsibling; s = s->nsibling )
-		    ;
-
-		s->nsibling = this;
-	    }
-	    else
-	    {
-		parent->fchild = this;
-	    }
-
-	    if ( !parent->yitem->isOpen() )
-	    {
-		SetState( S_HIDDEN );
-	    }
-	}
-
-	if ( !multiSel )
-	{
-	    Append( new NCTableCol( NCstring( std::string( prefixLen(), ' ' )
-					  + yitem->label() ) ) );
-	}
-	else
-	{
-	    Append( new NCTableCol( NCstring( std::string( prefixLen(), ' ' ) + "[ ] "
-					      + yitem->label() ) ) );
-	}
-    }
-
-    virtual ~NCTreeLine() { delete [] prefix; }
-
-public:
-
-    YTreeItem * YItem() const { return yitem; }
-
-    unsigned	Level() const { return level; }
-
-    virtual bool isVisible() const
-    {
-	return !parent || ( !isHidden() && parent->isVisible() );
-    }
-
-
-    virtual int ChangeToVisible()
-    {
-	if ( isVisible() )
-	    return 0;
-
-	if ( parent )
-	{
-	    parent->ChangeToVisible();
-
-	    for ( NCTreeLine * c = parent->fchild; c; c = c->nsibling )
-	    {
-		c->ClearState( S_HIDDEN );
-		c->YItem()->setOpen( true );
-	    }
-	}
-	else
-	{
-	    ClearState( S_HIDDEN );
-	    yitem->setOpen( true );
-	}
-
-	return 1;
-    }
-
-
-    virtual unsigned Hotspot( unsigned & at ) const
-    {
-	at = Level();
-	return 6;
-    }
-
-
-    virtual int	 handleInput( wint_t key )
-    {
-	if ( !fchild )
-	    return 0;
-
-	switch ( key )
-	{
-	    case KEY_IC:
-	    case '+':
-		if ( fchild->isVisible() )
-		    return 0;
-
-		break;
-
-	    case KEY_DC:
-	    case '-':
-		if ( !fchild->isVisible() )
-		    return 0;
-
-		break;
-
-	    case KEY_SPACE:
-            //	case KEY_RETURN: see bug 67350
-
-		break;
-
-	    default:
-		return 0;
-
-		break;
-	}
-
-	if ( fchild->isVisible() )
-	{
-	    yitem->setOpen( false );
-	    yuiMilestone() << "Closing item " << yitem->label() << std::endl;
-
-	    for ( NCTreeLine * c = fchild; c; c = c->nsibling )
-		c->SetState( S_HIDDEN );
-	}
-	else
-	{
-	    yitem->setOpen( true );
-	    yuiMilestone() << "Opening item " << yitem->label() << std::endl;
-
-	    for ( NCTreeLine * c = fchild; c; c = c->nsibling )
-		c->ClearState( S_HIDDEN );
-	}
-
-	return 1;
-    }
-
-
-    virtual void DrawAt( NCursesWindow & w, const wrect at,
-			 NCTableStyle & tableStyle,
-			 bool active ) const
-    {
-
-	NCTableLine::DrawAt( w, at, tableStyle, active );
-
-	if ( !isSpecial() )
-	    w.bkgdset( tableStyle.getBG( vstate, NCTableCol::SEPARATOR ) );
-
-	if ( ! prefix )
-	{
-	    prefix = new chtype[prefixLen()];
-	    chtype * tagend = &prefix[prefixLen()-1];
-	    *tagend-- = ACS_HLINE;
-	    *tagend-- = fchild ? ACS_TTEE : ACS_HLINE;
-
-	    if ( parent )
-	    {
-		*tagend-- = nsibling ? ACS_LTEE : ACS_LLCORNER;
-
-		for ( NCTreeLine * p = parent; p; p = p->parent )
-		{
-		    *tagend-- = p->nsibling ? ACS_VLINE : ( ' '&A_CHARTEXT );
-		}
-	    }
-	    else
-	    {
-		*tagend-- = ACS_HLINE;
-	    }
-	}
-
-	w.move( at.Pos.L, at.Pos.C );
-
-	unsigned i = 0;
-
-	for ( ; i < prefixLen(); ++i )
-	    w.addch( prefix[i] );
-
-	w.move( at.Pos.L, at.Pos.C + prefixLen() - 2 );
-
-	if ( fchild && !isSpecial() )
-	    w.bkgdset( tableStyle.highlightBG( vstate, NCTableCol::HINT,
-					       NCTableCol::SEPARATOR ) );
-
-	if ( fchild && !fchild->isVisible() )
-	    w.addch( '+' );
-	else
-	    w.addch( prefix[prefixLen() - 2] );
-    }
-};
-
-
-
-
+using stdutil::form;
 
 
 NCTree::NCTree( YWidget * parent, const std::string & nlabel, bool multiselection, bool recursiveselection )
     : YTree( parent, nlabel, multiselection, recursiveselection )
 	, NCPadWidget( parent )
 	, multiSel ( multiselection )
+	, filterMode( false )
+	, hintCols( 0 )
 {
     yuiDebug() << std::endl;
 
@@ -273,11 +61,11 @@ NCTree::~NCTree()
 
 
 
-// Return pointer to tree line	at given index
-inline const NCTreeLine * NCTree::getTreeLine( unsigned idx ) const
+// Return pointer to the tree line of item (created if necessary)
+inline NCTreeLine * NCTree::getTreeLine( YTreeItem * item )
 {
     if ( myPad() )
-	return dynamic_cast<const NCTreeLine *>( myPad()->GetLine( idx ) );
+	return myPad()->TreeLine( item );
     else
 	return 0;
 }
@@ -285,12 +73,14 @@ inline const NCTreeLine * NCTree::getTreeLine( unsigned idx ) const
 
 
 
-// Modify tree line at given index
-inline NCTreeLine * NCTree::modifyTreeLine( unsigned idx )
+// Modify the tree line of item, if it has one
+inline NCTreeLine * NCTree::modifyTreeLine( YTreeItem * item )
 {
-    if ( myPad() )
+    NCTreeLine * line = NCTreeLine::of( item );
+
+    if ( myPad() && line )
     {
-	return dynamic_cast<NCTreeLine *>( myPad()->ModifyLine( idx ) );
+	return myPad()->ModifyLine( line );
     }
 
     return 0;
@@ -382,15 +172,13 @@ void NCTree::selectItem( YItem *item, bool selected )
     YUI_CHECK_PTR( treeItem );
     YTreeItem *citem = getCurrentItem();
 
-    //retrieve position of item
-    int at = treeItem->index();
-
     NCTreeLine * cline = 0;	// current line
     NCTableCol * ccol = 0;	// current column
 
     if ( multiSel )
     {
-	cline = modifyTreeLine( at );
+	// a line not created yet gets its label from the item
+	cline = modifyTreeLine( treeItem );
 	if ( cline )
 	{
 	    ccol = cline->GetCol(0);
@@ -425,7 +213,7 @@ void NCTree::selectItem( YItem *item, bool selected )
 
 	//this highlights selected item, possibly unpacks the tree
 	//should it be in currently hidden branch
-	myPad()->ShowItem( getTreeLine( at ) );
+	myPad()->ShowItem( getTreeLine( treeItem ) );
     }
 }
 
@@ -458,8 +246,10 @@ void NCTree::setLabel( const std::string & nlabel )
 
 void NCTree::rebuildTree()
 {
-    DelPad();
-    Redraw();
+    if ( myPad() )
+	DrawPad();	// create the lines again in one go
+    else
+	Redraw();
 }
 
 
@@ -475,9 +265,12 @@ NCPad * NCTree::CreatePad()
 }
 
 
-// Creates tree lines and appends them to TreePad
-// (called recursively for each child of an item)
-void NCTree::CreateTreeLines( NCTreeLine * parentLine, NCTreePad * pad, YItem * item )
+// Numbers the items and creates the tree lines of the open branches
+// (called recursively for each child of an item). The lines of closed
+// branches are created by the pad when they are opened. The selected
+// items are collected in 'selected'.
+void NCTree::CreateTreeLines( NCTreePad * pad, YItem * item,
+			      std::vector<YTreeItem *> & selected )
 {
     //set item index explicitely, it is set to -1 by default
     //which makes selecting items painful
@@ -486,40 +279,100 @@ void NCTree::CreateTreeLines( NCTreeLine * parentLine, NCTreePad * pad, YItem *
     YTreeItem * treeItem = dynamic_cast<YTreeItem *>( item );
     YUI_CHECK_PTR( treeItem );
 
-    NCTreeLine * line = new NCTreeLine( parentLine, treeItem, multiSel );
-    pad->Append( line );
-
-    if (item->selected())
+    if ( item->selected() )
     {
-        //retrieve position of item
-        int at = treeItem->index();
-        NCTreeLine * cline = 0;     // current line
-        NCTableCol * ccol = 0;      // current column
-        if ( multiSel )
-        {
-            cline = modifyTreeLine( at );
-            if ( cline )
-            {
-                ccol = cline->GetCol(0);
-            }
-            if ( ccol )
-            {
-                ccol->SetLabel( NCstring( std::string( cline->Level() + 3, ' ' ) + "[x] "
-                                      + item->label() ) );
-            }
-        }
-        //this highlights selected item, possibly unpacks the tree
-        //should it be in currently hidden branch
-        pad->ShowItem( getTreeLine( at ) );
+        // shown when all lines are created
+        selected.push_back( treeItem );
     }
+
+    NCTreeLine * line = NCTreeLine::of( treeItem );
+
+    if ( line && treeItem->isOpen() )
+	pad->CreateChildren( line );
+
     // iterate over children
 
     for ( YItemIterator it = item->childrenBegin();  it < item->childrenEnd(); ++it )
     {
-	CreateTreeLines( line, pad, *it );
+	CreateTreeLines( pad, *it, selected );
     }
 }
 
+void NCTree::wRedraw()
+{
+    NCPadWidget::wRedraw();
+    hintCols = 0;	// the frame is drawn again
+    drawFilterHint();
+}
+
+
+
+// Type-to-filter: '/' starts entering a filter, every key typed shows
+// just the matching items (and their ancestors). Return keeps the
+// filter, Esc drops it.
+
+bool NCTree::handleFilterInput( wint_t key )
+{
+    if ( !myPad() )
+	return false;
+
+    bool wasFilterMode = filterMode;
+    std::wstring filter( myPad()->filter() );
+
+    bool handled = NCTableFilterIndex::editFilter( key, filterMode, filter );
+
+    if ( handled && wasFilterMode )
+	myPad()->setFilter( filter );
+
+    if ( filterMode != wasFilterMode )
+    {
+	Redraw();	// show or drop the hint
+    }
+    else if ( handled )
+    {
+	// setFilter drew the lines, just the hint changed
+	drawFilterHint();
+	Update();
+    }
+
+    return handled;
+}
+
+
+
+void NCTree::drawFilterHint()
+{
+    if ( !win || !myPad() || !( filterMode || myPad()->filtered() ) )
+	return;
+
+    std::wstring hint( L" /" + myPad()->filter() + ( filterMode ? L"_" : L"" ) );
+
+    if ( myPad()->filtered() )
+	hint += NCstring( form( " (%u) ", myPad()->filterMatches() ) ).str();
+    else
+	hint += L" ";
+
+    // right aligned in the upper frame line
+    int cols = NCwidth::columns( hint, NCurses::tabsize() );
+    int at = win->width() - 1 - cols;
+
+    if ( hintCols > cols )
+    {
+	// restore the frame under the rest of a longer hint
+	win->bkgdset( frameStyle().plain );
+	win->move( 0, std::max( 1, win->width() - 1 - hintCols ) );
+
+	for ( int i = cols; i < hintCols; ++i )
+	    win->addch( ACS_HLINE );
+    }
+
+    hintCols = cols;
+    win->bkgdset( frameStyle().hint );
+    win->addwstr( 0, std::max( 1, at ), hint.c_str() );
+}
+
+
+
 // Returns current item (pure virtual in YTree)
 YTreeItem * NCTree::currentItem()
 {
@@ -535,14 +388,48 @@ void NCTree::DrawPad()
 	return;
     }
 
-    idx = 0;
+    // create the lines later at once
+    if ( inMultidraw() )
+	return;
+
+    NCTreePad * pad = myPad();
+    std::vector<YTreeItem *> selected;
+
+    pad->ClearTable();
+
     // YItemIterator iterates over the toplevel items
     for ( YItemIterator it = itemsBegin(); it < itemsEnd(); ++it )
     {
-	CreateTreeLines( 0, myPad(), *it );
+	YTreeItem * treeItem = dynamic_cast<YTreeItem *>( *it );
+	YUI_CHECK_PTR( treeItem );
+
+	pad->Append( new ( pad->arena() ) NCTreeLine( 0, treeItem, multiSel ) );
+    }
+
+    idx = 0;
+
+    for ( YItemIterator it = itemsBegin(); it < itemsEnd(); ++it )
+    {
+	CreateTreeLines( pad, *it, selected );
     }
 
     idx = 0;
+
+    // this highlights selected items, possibly unpacks the tree should
+    // they be in currently hidden branches (formats the lines just once)
+    NCTreeLine * last = 0;
+
+    for ( unsigned i = 0; i < selected.size(); ++i )
+    {
+	last = pad->TreeLine( selected[i] );
+
+	if ( last )
+	    last->ChangeToVisible();
+    }
+
+    if ( last )
+	pad->ShowItem( last );
+
     NCPadWidget::DrawPad();
 }
 
@@ -553,7 +440,7 @@ NCursesEvent NCTree::wHandleInput( wint_t key )
     NCursesEvent ret = NCursesEvent::none;
     YTreeItem * oldCurrentItem = getCurrentItem();
 
-    bool handled = handleInput( key ); // NCTreePad::handleInput()
+    bool handled = handleFilterInput( key ) || handleInput( key ); // NCTreePad::handleInput()
     const YItem * currentItem = getCurrentItem();
 
     if ( !currentItem )
@@ -618,6 +505,7 @@ NCursesEvent NCTree::wHandleInput( wint_t key )
 //		      the values
 void NCTree::deleteAllItems()
 {
-    YTree::deleteAllItems();
+    // the lines refer to the items
     myPad()->ClearTable();
+    YTree::deleteAllItems();
 }
@@ -26,6 +26,7 @@
 #define NCTree_h
 
 #include <iosfwd>
+#include <vector>
 
 #include <yui/YTree.h>
 #include "NCPadWidget.h"
@@ -45,22 +46,33 @@ private:
 
     int idx;
     bool multiSel;
+    bool filterMode;
+    int  hintCols;	// of the filter hint drawn last
 
-    void CreateTreeLines( NCTreeLine * p, NCTreePad * pad, YItem * item );
+    void CreateTreeLines( NCTreePad * pad, YItem * item,
+			  std::vector<YTreeItem *> & selected );
 
 protected:
 
     virtual NCTreePad * myPad() const
     { return dynamic_cast<NCTreePad*>( NCPadWidget::myPad() ); }
 
-    const NCTreeLine * getTreeLine( unsigned idx ) const;
-    NCTreeLine *       modifyTreeLine( unsigned idx );
+    NCTreeLine * getTreeLine( YTreeItem * item );
+    NCTreeLine * modifyTreeLine( YTreeItem * item );
 
     virtual const char * location() const { return "NCTree"; }
 
     virtual NCPad * CreatePad();
     virtual void    DrawPad();
 
+    virtual void    wRedraw();
+
+    /** Handle \a key if it starts or edits the filter of the tree. */
+    bool handleFilterInput( wint_t key );
+
+    /** Show the filter in the upper frame line. */
+    void drawFilterHint();
+
     virtual void startMultipleChanges() { startMultidraw(); }
     virtual void doneMultipleChanges()	{ stopMultidraw(); }
 
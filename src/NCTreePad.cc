@@ -25,19 +25,240 @@
 #define  YUILogComponent "ncurses"
 #include <yui/YUILog.h>
 #include "NCTreePad.h"
+#include "NCwidth.h"
+
+#include <algorithm>
+#include <cwctype>
+
+// When the pad holds more lines, closing a branch drops its lines
+#define MAX_TREE_LINES	100000
+
+
+NCTreeLine::NCTreeLine( NCTreeLine * p, YTreeItem * item, bool multiSelection )
+	: NCTableLine( 0 )
+	, yitem( item )
+	, level( p ? p->level + 1 : 0 )
+	, parent( p )
+	, nsibling( 0 )
+	, psibling( p ? p->lchild : 0 )
+	, fchild( 0 )
+	, lchild( 0 )
+	, hiddenCount( p ? p->hiddenCount : 0 )
+	, shownByFilter( false )
+	, matchPos( -1 )
+	, slot( 0 )
+	, prefix( 0 )
+	, multiSel( multiSelection )
+{
+    if ( parent )
+    {
+	if ( parent->lchild )
+	    parent->lchild->nsibling = this;
+	else
+	    parent->fchild = this;
+
+	parent->lchild = this;
+
+	if ( !parent->yitem->isOpen() )
+	{
+	    SetState( S_HIDDEN );
+	    ++hiddenCount;
+	}
+    }
+
+    yitem->setData( this );
+
+    // allocate the column where the line was allocated (the pad's arena)
+    NCTableArena * arena = NCTableArena::of( this );
+
+    if ( !multiSel )
+    {
+	Append( new ( arena ) NCTableCol( NCstring( std::string( prefixLen(), ' ' )
+						  + yitem->label() ) ) );
+    }
+    else
+    {
+	Append( new ( arena ) NCTableCol( NCstring( std::string( prefixLen(), ' ' )
+						  + ( yitem->selected() ? "[x] " : "[ ] " )
+						  + yitem->label() ) ) );
+    }
+}
+
+
+
+NCTreeLine::~NCTreeLine()
+{
+    if ( yitem->data() == this )
+	yitem->setData( 0 );
+}
+
+
+
+int NCTreeLine::ChangeToVisible()
+{
+    if ( isVisible() )
+	return 0;
+
+    if ( parent )
+    {
+	parent->ChangeToVisible();
+	parent->yitem->setOpen( true );
+
+	for ( NCTreeLine * c = parent->fchild; c; c = c->nsibling )
+	{
+	    c->setHidden( false );
+	}
+    }
+    else
+    {
+	setHidden( false );
+    }
+
+    return 1;
+}
+
+
+
+void NCTreeLine::setHidden( bool hide )
+{
+    if ( hide == isHidden() )
+	return;
+
+    if ( hide )
+	SetState( S_HIDDEN );
+    else
+	ClearState( S_HIDDEN );
+
+    addHidden( hide ? 1 : -1 );
+}
+
+
+
+// Only the lines created so far are visited; new lines take the count
+// of their parent.
+void NCTreeLine::addHidden( int delta )
+{
+    hiddenCount += delta;
+
+    for ( NCTreeLine * c = fchild; c; c = c->nsibling )
+	c->addHidden( delta );
+}
+
+
+
+int NCTreeLine::handleInput( wint_t key )
+{
+    if ( !hasChildren() )
+	return 0;
+
+    switch ( key )
+    {
+	case KEY_IC:
+	case '+':
+	    if ( isOpen() )
+		return 0;
+
+	    break;
+
+	case KEY_DC:
+	case '-':
+	    if ( !isOpen() )
+		return 0;
+
+	    break;
+
+	case KEY_SPACE:
+	//	case KEY_RETURN: see bug 67350
+
+	    break;
+
+	default:
+	    return 0;
+
+	    break;
+    }
+
+    if ( isOpen() )
+    {
+	yitem->setOpen( false );
+	yuiMilestone() << "Closing item " << yitem->label() << std::endl;
+
+	for ( NCTreeLine * c = fchild; c; c = c->nsibling )
+	    c->setHidden( true );
+    }
+    else
+    {
+	// the pad creates the lines of the children if necessary
+	yitem->setOpen( true );
+	yuiMilestone() << "Opening item " << yitem->label() << std::endl;
+
+	for ( NCTreeLine * c = fchild; c; c = c->nsibling )
+	    c->setHidden( false );
+    }
+
+    return 1;
+}
+
 
 
+void NCTreeLine::DrawAt( NCursesWindow & w, const wrect at,
+			 NCTableStyle & tableStyle,
+			 bool active ) const
+{
+
+    NCTableLine::DrawAt( w, at, tableStyle, active );
+
+    if ( !isSpecial() )
+	w.bkgdset( tableStyle.getBG( vstate, NCTableCol::SEPARATOR ) );
+
+    w.move( at.Pos.L, at.Pos.C );
+
+    // the connectors to the ancestors and siblings are precomputed,
+    // the marker depends on the item's current state
+    if ( prefix )
+    {
+	for ( unsigned i = 0; i <= level; ++i )
+	    w.addch( prefix[i] );
+    }
+    else
+    {
+	w.move( at.Pos.L, at.Pos.C + level + 1 );
+    }
+
+    w.addch( hasChildren() ? ACS_TTEE : ACS_HLINE );
+    w.addch( ACS_HLINE );
+
+    w.move( at.Pos.L, at.Pos.C + prefixLen() - 2 );
+
+    if ( hasChildren() && !isSpecial() )
+	w.bkgdset( tableStyle.highlightBG( vstate, NCTableCol::HINT,
+					   NCTableCol::SEPARATOR ) );
+
+    if ( hasChildren() && !isOpen() )
+	w.addch( '+' );
+    else
+	w.addch( hasChildren() ? ACS_TTEE : ACS_HLINE );
+}
 
+
+
+
+
+// Like the NCTablePad, the NCTreePad is virtual: the NCursesPad holds
+// just the visible lines, which are drawn on demand via directDraw.
 NCTreePad::NCTreePad( int lines, int cols, const NCWidget & p )
-	: NCPad( lines, cols, p )
+	: NCPad( lines, cols, p, true )
 	, Headpad( 1, 1 )
 	, dirtyHead( false )
 	, dirtyFormat( false )
 	, ItemStyle( p )
 	, Headline( 0 )
 	, Items( 0 )
+	, holes( 0 )
+	, prefixGarbage( 0 )
 	, visItems( 0 )
 	, citem( 0 )
+	, filterHits( 0 )
 {
 }
 
@@ -74,11 +295,22 @@ void NCTreePad::SetLines( unsigned idx )
     }
 
     Items.resize( idx, 0 );
+    holes = std::count( Items.begin(), Items.end(), ( NCTableLine * )0 );
+
+    if ( idx == 0 )
+    {
+	// all lines dropped: release their memory at once
+	visItems.clear();
+	prefixBuf.clear();
+	filterShown.clear();
+	filterIndex.clear();
+	lineArena.clear();
+    }
 
     for ( unsigned i = olines; i < Lines(); ++i )
     {
 	if ( !Items[i] )
-	    Items[i] = new NCTableLine( 0 );
+	    Items[i] = new ( arena() ) NCTableLine( 0 );
     }
 
     DirtyFormat();
@@ -94,9 +326,15 @@ void NCTreePad::SetLines( std::vector<NCTableLine*> & nItems )
     for ( unsigned i = 0; i < Lines(); ++i )
     {
 	if ( !Items[i] )
-	    Items[i] = new NCTableLine( 0 );
+	    Items[i] = new ( arena() ) NCTableLine( 0 );
+
+	NCTreeLine * line = dynamic_cast<NCTreeLine *>( Items[i] );
+
+	if ( line )
+	    line->slot = i;
     }
 
+    rebuildPrefixes( 0 );
     DirtyFormat();
 }
 
@@ -104,9 +342,29 @@ void NCTreePad::SetLines( std::vector<NCTableLine*> & nItems )
 
 void NCTreePad::AddLine( unsigned idx, NCTableLine * item )
 {
+    if ( idx == Lines() )
+    {
+	// appending needs no placeholder line
+	pushLine( item ? item : new ( arena() ) NCTableLine( 0 ) );
+	addPrefix( item );
+	DirtyFormat();
+	return;
+    }
+
     assertLine( idx );
+
+    if ( !Items[idx] )
+	--holes;
+
     delete Items[idx];
-    Items[idx] = item ? item : new NCTableLine( 0 );
+    Items[idx] = item ? item : new ( arena() ) NCTableLine( 0 );
+
+    NCTreeLine * line = dynamic_cast<NCTreeLine *>( item );
+
+    if ( line )
+	line->slot = idx;
+
+    addPrefix( item );
 
     DirtyFormat();
 }
@@ -115,7 +373,7 @@ void NCTreePad::AddLine( unsigned idx, NCTableLine * item )
 
 void NCTreePad::DelLine( unsigned idx )
 {
-    if ( idx < Lines() )
+    if ( idx < Lines() && Items[idx] )
     {
 	Items[idx]->ClearLine();
 	DirtyFormat();
@@ -219,17 +477,57 @@ wsze NCTreePad::UpdateFormat()
 {
     dirty = true;
     dirtyFormat = false;
+
+    // hidden lines keep no widths (see showChildren/hideChildren)
+    for ( unsigned l = 0; l < Lines(); ++l )
+    {
+	if ( Items[l] )
+	    Items[l]->ClearFormat( ItemStyle );
+    }
+
+    resetFiltered();
     visItems.clear();
     ItemStyle.ResetToMinCols();
 
+    if ( filtered() )
+	applyFilter();
+    else
+	collectVisible();
+
+    for ( unsigned l = 0; l < visLines(); ++l )
+    {
+	visItems[l]->UpdateFormat( ItemStyle );
+    }
+
+    return UpdateSize();
+}
+
+
+
+// Children may be created after their parent's siblings, so the
+// visible lines are collected in tree order starting at the roots.
+void NCTreePad::collectVisible()
+{
     for ( unsigned l = 0; l < Lines(); ++l )
     {
-	Items[l]->UpdateFormat( ItemStyle );
+	NCTreeLine * line = dynamic_cast<NCTreeLine *>( Items[l] );
 
-	if ( Items[l]->isVisible() )
-	    visItems.push_back( Items[l] );
+	if ( !line )
+	{
+	    if ( Items[l] && Items[l]->isVisible() )
+		visItems.push_back( Items[l] );
+	}
+	else if ( !line->Parent() )
+	{
+	    addVisible( line, visItems );
+	}
     }
+}
+
 
+
+wsze NCTreePad::UpdateSize()
+{
     maxspos.L = visLines() > ( unsigned )srect.Sze.H ? visLines() - srect.Sze.H : 0;
 
     resize( wsze( visLines(), ItemStyle.TableWidth() ) );
@@ -238,6 +536,573 @@ wsze NCTreePad::UpdateFormat()
 
 
 
+// The index lists the items rather than the lines, so lines need not be
+// created for filtering. It is dropped with the lines (see SetLines),
+// i.e. built once per NCTree::rebuildTree.
+void NCTreePad::indexItems( const YTreeItem * item )
+{
+    std::wstring text( NCstring( item->label() ).str() );
+
+    for ( std::wstring::iterator it = text.begin(); it != text.end(); ++it )
+	*it = std::towlower( *it );
+
+    filterIndex.update( item, text );
+
+    for ( YItemConstIterator it = item->childrenBegin(); it < item->childrenEnd(); ++it )
+    {
+	const YTreeItem * child = dynamic_cast<const YTreeItem *>( *it );
+
+	if ( child )
+	    indexItems( child );
+    }
+}
+
+
+
+// Collect the matching items and their ancestors, then show their lines
+// in tree order. Just the lines of the shown items' children are created.
+void NCTreePad::applyFilter()
+{
+    std::vector<NCTreeLine *> roots;
+
+    for ( unsigned l = 0; l < Lines(); ++l )
+    {
+	NCTreeLine * line = dynamic_cast<NCTreeLine *>( Items[l] );
+
+	if ( line && !line->Parent() )
+	    roots.push_back( line );
+    }
+
+    if ( filterIndex.empty() )
+    {
+	for ( unsigned i = 0; i < roots.size(); ++i )
+	    indexItems( roots[i]->YItem() );
+    }
+
+    std::vector<const void *> hits;
+    filterIndex.mark( filterText, &hits );
+    filterHits = hits.size();
+
+    for ( unsigned h = 0; h < hits.size(); ++h )
+    {
+	const YTreeItem * item = static_cast<const YTreeItem *>( hits[h] );
+
+	filterShown.insert( std::make_pair( item, false ) );
+
+	// stop at an ancestor shown for another match
+	for ( const YTreeItem * p = item->parent(); p; p = p->parent() )
+	{
+	    bool & ancestor( filterShown[p] );
+
+	    if ( ancestor )
+		break;
+
+	    ancestor = true;
+	}
+    }
+
+    for ( unsigned i = 0; i < roots.size(); ++i )
+    {
+	if ( filterShown.count( roots[i]->YItem() ) )
+	    addFiltered( roots[i] );
+    }
+}
+
+
+
+void NCTreePad::addFiltered( NCTreeLine * line )
+{
+    // where to highlight the match (see drawLine)
+    const std::wstring * text = filterIndex.text( line->YItem() );
+    std::wstring::size_type pos = text ? text->find( filterText ) : std::wstring::npos;
+
+    line->shownByFilter = true;
+    line->matchPos = ( pos == std::wstring::npos ? -1 : ( int )pos );
+    visItems.push_back( line );
+
+    if ( !filterShown[line->YItem()] )
+	return;		// no match below
+
+    appendChildren( line );
+
+    for ( NCTreeLine * c = line->FirstChild(); c; c = c->NextSibling() )
+    {
+	if ( filterShown.count( c->YItem() ) )
+	    addFiltered( c );
+    }
+}
+
+
+
+// The lines of the items shown before are no longer visible just for
+// the filter.
+void NCTreePad::resetFiltered()
+{
+    for ( std::unordered_map<const YTreeItem *, bool>::const_iterator it = filterShown.begin();
+	  it != filterShown.end(); ++it )
+    {
+	NCTreeLine * line = NCTreeLine::of( it->first );
+
+	if ( line )
+	    line->shownByFilter = false;
+    }
+
+    filterShown.clear();
+}
+
+
+
+void NCTreePad::setFilter( const std::wstring & filter )
+{
+    std::wstring nfilter( filter );
+
+    for ( std::wstring::iterator it = nfilter.begin(); it != nfilter.end(); ++it )
+	*it = std::towlower( *it );
+
+    if ( nfilter == filterText )
+	return;
+
+    // keep the current line if it is still shown
+    const NCTableLine * current = GetCurrentLine();
+
+    filterText = nfilter;
+
+    if ( dirtyFormat )
+	UpdateFormat();
+    else
+    {
+	// just the lines shown before and now are measured
+	for ( unsigned l = 0; l < visLines(); ++l )
+	    visItems[l]->ClearFormat( ItemStyle );
+
+	resetFiltered();
+	visItems.clear();
+
+	if ( filtered() )
+	    applyFilter();
+	else
+	    collectVisible();
+
+	for ( unsigned l = 0; l < visLines(); ++l )
+	    visItems[l]->UpdateFormat( ItemStyle );
+
+	UpdateSize();
+    }
+
+    unsigned row = 0;
+
+    for ( unsigned l = 0; l < visLines(); ++l )
+    {
+	if ( visItems[l] == current )
+	{
+	    row = l;
+	    break;
+	}
+    }
+
+    citem.L = -1;	// force setpos to adjust the hotspot
+    setpos( wpos( row, srect.Pos.C ) );
+}
+
+
+
+// Draw the line at row and highlight the text matching the filter.
+void NCTreePad::drawLine( NCursesWindow & w, const wrect at, unsigned row, bool active )
+{
+    NCTableLine * item = visItems[row];
+
+    item->DrawAt( w, at, ItemStyle, active );
+
+    NCTreeLine * line = dynamic_cast<NCTreeLine *>( item );
+
+    if ( !filtered() || !line || !line->shownByFilter || line->matchPos < 0 )
+	return;
+
+    // the label follows the prefix and the selection tag in the cell
+    const NCTableCol * cell = line->GetCol( 0 );
+
+    if ( !cell || cell->Label().getText().empty() )
+	return;
+
+    const std::wstring & text( cell->Label().getText().front().str() );
+    std::wstring::size_type pos = line->prefixLen() + ( line->multiSelection() ? 4 : 0 ) + line->matchPos;
+
+    if ( pos + filterText.size() > text.size() )
+	return;		// not on the first line of the label
+
+    int col = NCwidth::columns( text.c_str(), pos, NCurses::tabsize() );
+
+    w.bkgdset( ItemStyle.getBG( active ? NCTableLine::S_ACTIVE : NCTableLine::S_NORMAL,
+				NCTableCol::HINT ) );
+    w.addwstr( at.Pos.L, at.Pos.C + col, text.substr( pos, filterText.size() ).c_str() );
+}
+
+
+
+void NCTreePad::directDraw( NCursesWindow & w, const wrect at, unsigned lineno )
+{
+    if ( lineno < visLines() )
+	drawLine( w, at, lineno, ( ( unsigned )citem.L == lineno ) );
+    else
+	yuiWarning() << "Illegal Lineno " << lineno << " (" << visLines() << ")" << std::endl;
+}
+
+
+
+void NCTreePad::addVisible( NCTreeLine * line, std::vector<NCTableLine *> & lines )
+{
+    lines.push_back( line );
+    addVisibleChildren( line, lines );
+}
+
+
+
+void NCTreePad::addVisibleChildren( NCTreeLine * line, std::vector<NCTableLine *> & lines )
+{
+    if ( !line->isOpen() )
+	return;
+
+    // e.g. opened by the application
+    appendChildren( line );
+
+    for ( NCTreeLine * c = line->FirstChild(); c; c = c->NextSibling() )
+    {
+	if ( !c->isHidden() )
+	    addVisible( c, lines );
+    }
+}
+
+
+
+// Like CreateChildren, but leaves the format alone.
+void NCTreePad::appendChildren( NCTreeLine * line )
+{
+    if ( line->childrenCreated() )
+	return;
+
+    YTreeItem * parent = line->YItem();
+
+    for ( YItemIterator it = parent->childrenBegin(); it < parent->childrenEnd(); ++it )
+    {
+	YTreeItem * item = dynamic_cast<YTreeItem *>( *it );
+
+	if ( item )
+	    pushLine( new ( arena() ) NCTreeLine( line, item, line->multiSelection() ) );
+    }
+
+    // after all siblings are linked
+    for ( NCTreeLine * c = line->FirstChild(); c; c = c->NextSibling() )
+	assignPrefix( c );
+}
+
+
+
+void NCTreePad::CreateChildren( NCTreeLine * line )
+{
+    if ( !line || line->childrenCreated() )
+	return;
+
+    appendChildren( line );
+    DirtyFormat();
+}
+
+
+
+// The line at visItems[pos] was opened: insert the lines that became
+// visible after it and add their widths.
+void NCTreePad::showChildren( unsigned pos )
+{
+    NCTreeLine * line = static_cast<NCTreeLine *>( visItems[pos] );
+    std::vector<NCTableLine *> lines;
+
+    addVisibleChildren( line, lines );
+
+    for ( unsigned i = 0; i < lines.size(); ++i )
+	lines[i]->UpdateFormat( ItemStyle );
+
+    visItems.insert( visItems.begin() + pos + 1, lines.begin(), lines.end() );
+}
+
+
+
+// The line at visItems[pos] was closed: remove the visible lines below
+// it and withdraw their widths.
+void NCTreePad::hideChildren( unsigned pos )
+{
+    NCTreeLine * line = static_cast<NCTreeLine *>( visItems[pos] );
+    unsigned end = pos + 1;
+
+    for ( ; end < visLines(); ++end )
+    {
+	NCTreeLine * l = dynamic_cast<NCTreeLine *>( visItems[end] );
+
+	if ( !l || l->Level() <= line->Level() )
+	    break;
+
+	l->ClearFormat( ItemStyle );
+    }
+
+    visItems.erase( visItems.begin() + pos + 1, visItems.begin() + end );
+
+    if ( Lines() - holes > MAX_TREE_LINES )
+	releaseChildren( line );
+}
+
+
+
+NCTreeLine * NCTreePad::TreeLine( YTreeItem * item )
+{
+    if ( !item )
+	return 0;
+
+    NCTreeLine * line = NCTreeLine::of( item );
+
+    if ( line )
+	return line;
+
+    NCTreeLine * pline = TreeLine( item->parent() );
+
+    if ( !pline || pline->childrenCreated() )
+	return 0;
+
+    CreateChildren( pline );
+
+    return NCTreeLine::of( item );
+}
+
+
+
+NCTreeLine * NCTreePad::ModifyLine( NCTreeLine * line )
+{
+    DirtyFormat();
+    return line;
+}
+
+
+
+// A line was added by AddLine: give it a prefix and fix the one of its
+// previous sibling.
+void NCTreePad::addPrefix( NCTableLine * item )
+{
+    NCTreeLine * line = dynamic_cast<NCTreeLine *>( item );
+
+    if ( !line )
+	return;
+
+    siblingAdded( line );
+    assignPrefix( line );
+
+    // a new root: index it with the others
+    if ( !line->parent )
+	filterIndex.clear();
+}
+
+
+
+// The prefix of a line consists of the connectors of its ancestors
+// (a vertical line if the ancestor has a next sibling) and its own
+// connector. All prefixes are stored in prefixBuf. The buffer grows
+// like a vector, but by rebuilding all prefixes in one pass, so the
+// lines' pointers stay valid and dropped lines leave no garbage.
+void NCTreePad::assignPrefix( NCTreeLine * line )
+{
+    if ( line->prefix )
+	return;
+
+    if ( line->parent && !line->parent->prefix )
+	assignPrefix( line->parent );
+
+    if ( prefixBuf.size() + line->level + 1 > prefixBuf.capacity() )
+    {
+	rebuildPrefixes( line->level + 1 );
+
+	if ( line->prefix )
+	    return;
+    }
+
+    appendPrefix( line );
+}
+
+
+
+// prefixBuf must have room for the prefix.
+void NCTreePad::appendPrefix( NCTreeLine * line )
+{
+    std::size_t at = prefixBuf.size();
+
+    if ( line->parent )
+    {
+	// copied by index: the parent's prefix is in prefixBuf, too
+	std::size_t pp = line->parent->prefix - &prefixBuf[0];
+
+	for ( unsigned i = 0; i < line->parent->level; ++i )
+	    prefixBuf.push_back( prefixBuf[pp + i] );
+
+	prefixBuf.push_back( line->parent->nsibling ? ACS_VLINE : ( ' '&A_CHARTEXT ) );
+	prefixBuf.push_back( line->nsibling ? ACS_LTEE : ACS_LLCORNER );
+    }
+    else
+    {
+	prefixBuf.push_back( ACS_HLINE );
+    }
+
+    line->prefix = &prefixBuf[at];
+}
+
+
+
+void NCTreePad::appendPrefixes( NCTreeLine * line )
+{
+    appendPrefix( line );
+
+    for ( NCTreeLine * c = line->fchild; c; c = c->nsibling )
+	appendPrefixes( c );
+}
+
+
+
+void NCTreePad::rebuildPrefixes( std::size_t extra )
+{
+    std::size_t need = extra;
+    std::vector<NCTreeLine *> roots;
+
+    for ( unsigned l = 0; l < Lines(); ++l )
+    {
+	NCTreeLine * line = dynamic_cast<NCTreeLine *>( Items[l] );
+
+	if ( line )
+	{
+	    need += line->level + 1;
+	    line->prefix = 0;
+
+	    if ( !line->parent )
+		roots.push_back( line );
+	}
+    }
+
+    std::vector<chtype> buf;
+    buf.reserve( 2 * need );
+    prefixBuf.swap( buf );
+    prefixGarbage = 0;
+
+    for ( unsigned i = 0; i < roots.size(); ++i )
+	appendPrefixes( roots[i] );
+}
+
+
+
+// line was appended to its parent's children: its previous sibling
+// and the lines below that one get connected to it.
+void NCTreePad::siblingAdded( NCTreeLine * line )
+{
+    NCTreeLine * prev = line->psibling;
+
+    if ( !prev || !prev->prefix )
+	return;
+
+    prev->prefix[prev->level] = ACS_LTEE;
+
+    std::vector<NCTableLine *> below;
+    collectChildren( prev, below );
+
+    for ( unsigned i = 0; i < below.size(); ++i )
+    {
+	NCTreeLine * l = static_cast<NCTreeLine *>( below[i] );
+
+	if ( l->prefix )
+	    l->prefix[prev->level] = ACS_VLINE;
+    }
+}
+
+
+
+void NCTreePad::collectChildren( NCTreeLine * line, std::vector<NCTableLine *> & lines )
+{
+    for ( NCTreeLine * c = line->FirstChild(); c; c = c->NextSibling() )
+    {
+	lines.push_back( c );
+	collectChildren( c, lines );
+    }
+}
+
+
+
+// Drop the lines below line. They are created again when line is
+// opened next time. Their slots in Items and their prefixes are left
+// as holes, which are removed once they make up half of the storage:
+// releasing a branch costs the size of the branch.
+void NCTreePad::releaseChildren( NCTreeLine * line )
+{
+    std::vector<NCTableLine *> drop;
+    collectChildren( line, drop );
+
+    if ( drop.empty() )
+	return;
+
+    yuiDebug() << "Dropping " << drop.size() << " lines below " << line->YItem()->label() << std::endl;
+
+    // the lines are hidden, so they hold no widths
+    for ( unsigned i = 0; i < drop.size(); ++i )
+    {
+	NCTreeLine * l = static_cast<NCTreeLine *>( drop[i] );
+
+	Items[l->slot] = 0;
+	++holes;
+
+	if ( l->prefix )
+	    prefixGarbage += l->level + 1;
+
+	delete l;
+    }
+
+    line->fchild = line->lchild = 0;
+
+    if ( holes > Lines() / 2 )
+	compactLines();
+
+    if ( prefixGarbage > prefixBuf.size() / 2 )
+	rebuildPrefixes( 0 );
+}
+
+
+
+void NCTreePad::pushLine( NCTableLine * item )
+{
+    NCTreeLine * line = dynamic_cast<NCTreeLine *>( item );
+
+    if ( line )
+	line->slot = Lines();
+
+    Items.push_back( item );
+}
+
+
+
+// Remove the holes left by releaseChildren, keeping the order of the
+// lines.
+void NCTreePad::compactLines()
+{
+    unsigned to = 0;
+
+    for ( unsigned l = 0; l < Lines(); ++l )
+    {
+	if ( !Items[l] )
+	    continue;
+
+	NCTreeLine * line = dynamic_cast<NCTreeLine *>( Items[l] );
+
+	if ( line )
+	    line->slot = to;
+
+	Items[to++] = Items[l];
+    }
+
+    Items.resize( to );
+    holes = 0;
+}
+
+
+
 int NCTreePad::DoRedraw()
 {
     if ( !Destwin() )
@@ -255,11 +1120,14 @@ int NCTreePad::DoRedraw()
 
     wsze lSze( 1, width() );
 
-    for ( unsigned l = 0; l < visLines(); ++l )
+    if ( ! pageing() )
     {
-	visItems[l]->DrawAt( *this, wrect( wpos( l, 0 ), lSze ),
-			     ItemStyle, ( l == ( unsigned )citem.L ) );
+	for ( unsigned l = 0; l < visLines(); ++l )
+	{
+	    drawLine( *this, wrect( wpos( l, 0 ), lSze ), l, l == ( unsigned )citem.L );
+	}
     }
+    // else: item drawing requested via directDraw
 
     if ( Headpad.width() != width() )
 	Headpad.resize( 1, width() );
@@ -333,15 +1201,16 @@ int NCTreePad::setpos( const wpos & newpos )
     }
 
     // adjust only
-    if ( citem.L != oitem )
+    if ( ! pageing() )
     {
-	visItems[oitem]->DrawAt( *this, wrect( wpos( oitem, 0 ), wsze( 1, width() ) ),
-				 ItemStyle, false );
-    }
-
-    visItems[citem.L]->DrawAt( *this, wrect( wpos( citem.L, 0 ), wsze( 1, width() ) ),
+	if ( citem.L != oitem )
+	{
+	    drawLine( *this, wrect( wpos( oitem, 0 ), wsze( 1, width() ) ), oitem, false );
+	}
 
-			       ItemStyle, true );
+	drawLine( *this, wrect( wpos( citem.L, 0 ), wsze( 1, width() ) ), citem.L, true );
+    }
+    // else: item drawing requested via directDraw
 
     if ( srect.Pos.C != opos )
 	SendHead();
@@ -392,9 +1261,23 @@ bool NCTreePad::handleInput( wint_t key )
 	case KEY_SPACE:
         //  case KEY_RETURN: - see bug 67350
 
+	    if ( dirtyFormat )
+		UpdateFormat();
+
 	    if ( visItems[citem.L]->handleInput( key ) )
 	    {
-		UpdateFormat();
+		NCTreeLine * line = dynamic_cast<NCTreeLine *>( visItems[citem.L] );
+
+		// only the lines below the toggled one change
+		if ( !line || filtered() )
+		    UpdateFormat();
+		else if ( line->isOpen() )
+		    showChildren( citem.L );
+		else
+		    hideChildren( citem.L );
+
+		dirty = true;
+		UpdateSize();
 		setpos( wpos( citem.L, srect.Pos.C ) );
 	    }
 
@@ -27,15 +27,109 @@
 
 #include <iosfwd>
 #include <vector>
+#include <unordered_map>
 
 #include "NCTableItem.h"
+#include "NCTablePad.h"
 #include "NCPad.h"
 #include "NCstring.h"
 
+#include <yui/YTreeItem.h>
+
 class NCTableLine;
 class NCTableCol;
 
 
+/**
+ * A line of a NCTreePad, showing a YTreeItem. The lines of the children
+ * of an item are created when the item is opened the first time (see
+ * NCTreePad::CreateChildren). The line is stored as data() of its item.
+ **/
+class NCTreeLine : public NCTableLine
+{
+
+private:
+
+    YTreeItem *		yitem;
+    const unsigned	level;
+
+    NCTreeLine * parent;
+    NCTreeLine * nsibling;
+    NCTreeLine * psibling;	// previous sibling, to fix its prefix in O(1)
+    NCTreeLine * fchild;
+    NCTreeLine * lchild;	// last child, to append in O(1)
+
+    /** Number of hidden lines on the path from the root to this line
+     * (including this one). The line is visible if it is 0.
+     **/
+    unsigned hiddenCount;
+
+    bool shownByFilter;	// shown by the pad's filter
+    int  matchPos;	// of the filter in the label (if shownByFilter), -1 if none
+
+    unsigned slot;	// index in the pad's Items
+
+    chtype * prefix;	// level + 1 chars in the pad's prefix buffer
+    bool multiSel;
+    unsigned prefixLen() const { return level + 3; }
+
+    void setHidden( bool hide );
+    void addHidden( int delta );
+
+    friend class NCTreePad;
+
+public:
+
+    NCTreeLine( NCTreeLine * p, YTreeItem * item, bool multiSelection );
+
+    virtual ~NCTreeLine();
+
+public:
+
+    YTreeItem * YItem() const { return yitem; }
+
+    unsigned	Level() const { return level; }
+
+    NCTreeLine * Parent()      const { return parent; }
+    NCTreeLine * FirstChild()  const { return fchild; }
+    NCTreeLine * NextSibling() const { return nsibling; }
+
+    bool	hasChildren() const { return yitem->hasChildren(); }
+
+    bool	isOpen() const { return yitem->isOpen(); }
+
+    /** Whether the lines of the children were created. */
+    bool	childrenCreated() const { return fchild != 0 || !hasChildren(); }
+
+    bool	multiSelection() const { return multiSel; }
+
+    /** The line of \a item, if created (see NCTreePad::TreeLine). */
+    static NCTreeLine * of( const YTreeItem * item )
+    {
+	return static_cast<NCTreeLine *>( item->data() );
+    }
+
+    virtual bool isVisible() const
+    {
+	return hiddenCount == 0 || shownByFilter;
+    }
+
+    virtual int ChangeToVisible();
+
+    virtual unsigned Hotspot( unsigned & at ) const
+    {
+	at = Level();
+	return 6;
+    }
+
+    virtual int	 handleInput( wint_t key );
+
+    virtual void DrawAt( NCursesWindow & w, const wrect at,
+			 NCTableStyle & tableStyle,
+			 bool active ) const;
+};
+
+
 class NCTreePad : public NCPad
 {
 private:
@@ -46,30 +140,79 @@ private:
     NCTreePad( const NCTreePad & );
 
 
+    NCTableArena	lineArena;	// outlives the lines
+
     NCursesPad	Headpad;
     bool	dirtyHead;
     bool	dirtyFormat;
 
     NCTableStyle	 ItemStyle;
     NCTableLine		 Headline;
+
+    /** The tree connectors of all lines, see assignPrefix */
+    std::vector<chtype>	 prefixBuf;
+
+    /** The lines. The slots of released lines are 0 (see releaseChildren). */
     std::vector<NCTableLine*> Items;
+    unsigned		 holes;		// released slots in Items
+    std::size_t		 prefixGarbage;	// prefixes of released lines
     std::vector<NCTableLine*> visItems;
     wpos		 citem;
 
+    /** The labels of all items, built when filtering the first time. */
+    NCTableFilterIndex	 filterIndex;
+    std::wstring	 filterText;
+    unsigned		 filterHits;
+
+    /** The items shown by the filter, mapped to whether they are shown
+     * for a matching descendant.
+     */
+    std::unordered_map<const YTreeItem *, bool> filterShown;
+
     void assertLine( unsigned idx );
 
+    void addVisible( NCTreeLine * line, std::vector<NCTableLine *> & lines );
+    void addVisibleChildren( NCTreeLine * line, std::vector<NCTableLine *> & lines );
+    void appendChildren( NCTreeLine * line );
+    void showChildren( unsigned pos );
+    void hideChildren( unsigned pos );
+    void addPrefix( NCTableLine * item );
+    void assignPrefix( NCTreeLine * line );
+    void appendPrefix( NCTreeLine * line );
+    void appendPrefixes( NCTreeLine * line );
+    void rebuildPrefixes( std::size_t extra );
+    void siblingAdded( NCTreeLine * line );
+
+    void indexItems( const YTreeItem * item );
+    void applyFilter();
+    void collectVisible();
+    void addFiltered( NCTreeLine * line );
+    void resetFiltered();
+
+    void drawLine( NCursesWindow & w, const wrect at, unsigned row, bool active );
+
+    void collectChildren( NCTreeLine * line, std::vector<NCTableLine *> & lines );
+    void releaseChildren( NCTreeLine * line );
+    void pushLine( NCTableLine * item );
+    void compactLines();
+
 protected:
 
     void	 DirtyFormat() { dirty = dirtyFormat = true; }
 
     virtual wsze UpdateFormat();
 
+    /** Resize the pad to the visible lines and the current column widths. */
+    wsze UpdateSize();
+
     virtual int  dirtyPad() { return setpos( CurPos() ); }
 
     virtual int  setpos( const wpos & newpos );
     virtual int  DoRedraw();
     virtual void updateScrollHint();
 
+    virtual void directDraw( NCursesWindow & w, const wrect at, unsigned lineno );
+
 public:
 
     NCTreePad( int lines, int cols, const NCWidget & p );
@@ -96,6 +239,11 @@ public:
 	dirtyHead = false;
     }
 
+    /** The arena to allocate the lines and columns of this pad from,
+     * i.e. use \c new(pad->arena()) to create them.
+     */
+    NCTableArena * arena() { return &lineArena; }
+
     unsigned Cols()	const { return ItemStyle.Cols(); }
 
     unsigned Lines()	const { return Items.size(); }
@@ -108,7 +256,7 @@ public:
 
     void Append( NCTableLine * item )		{ AddLine( Lines(), item ); }
 
-    void Append( std::vector<NCTableCol*> & nItems ) { AddLine( Lines(), new NCTableLine( nItems ) ); }
+    void Append( std::vector<NCTableCol*> & nItems ) { AddLine( Lines(), new ( arena() ) NCTableLine( nItems ) ); }
 
     void AddLine( unsigned idx, NCTableLine * item );
     void DelLine( unsigned idx );
@@ -119,6 +267,33 @@ public:
     NCTableLine *	ModifyLine( unsigned idx );
 
     void ShowItem( const NCTableLine * item );
+
+    /**
+     * The line of \a item. The lines of its ancestors' children are
+     * created if necessary. Returns \c 0 if \a item has no line in
+     * this pad.
+     */
+    NCTreeLine * TreeLine( YTreeItem * item );
+
+    /** Create the lines of the children of \a line (if not done yet). */
+    void CreateChildren( NCTreeLine * line );
+
+    /** Request to measure \a line again (e.g. its label changed). */
+    NCTreeLine * ModifyLine( NCTreeLine * line );
+
+    /**
+     * Show only the items whose label contains \a filter (ignoring
+     * case) and their ancestors. The matches are highlighted. An empty
+     * filter shows the tree again.
+     */
+    void setFilter( const std::wstring & filter );
+
+    const std::wstring & filter() const { return filterText; }
+
+    bool filtered() const { return !filterText.empty(); }
+
+    /** The number of items matching the filter. */
+    unsigned filterMatches() const { return filterHits; }
 };
 
 
@@ -29,6 +29,7 @@
 #define  YUILogComponent "ncurses"
 #include <yui/YUILog.h>
 #include "NCstring.h"
+#include "NCwidth.h"
 
 
 // The default encoding is UTF-8. For real terminals this may be
@@ -373,7 +374,7 @@ void NCstring::getHotkey( ) const
 	size_t realpos = 0, t;
 
 	for ( t = 0; t < tpos; t++ )
-	    realpos += wcwidth( wstr[t] );
+	    realpos += NCwidth::of( wstr[t] );
 
 	wstr.erase( tpos, 1 );
 
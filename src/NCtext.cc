@@ -26,8 +26,9 @@
 #include <yui/YUILog.h>
 #include "NCtext.h"
 #include "stringutil.h"
+#include "NCwidth.h"
 
-#include <wchar.h>		// wcwidth
+#include <algorithm>
 #include <langinfo.h>
 
 #include <boost/algorithm/string.hpp>
@@ -38,6 +39,7 @@ const NCstring NCtext::emptyStr;
 
 
 NCtext::NCtext( const NCstring & nstr )
+    : mcolumns( 0 )
 {
     lset( nstr );
 }
@@ -45,6 +47,7 @@ NCtext::NCtext( const NCstring & nstr )
 
 
 NCtext::NCtext( const NCstring & nstr, size_t columns )
+    : mcolumns( 0 )
 {
     lbrset( nstr, columns );
 }
@@ -62,6 +65,7 @@ void NCtext::lset( const NCstring & ntext )
 
     mtext.clear();
     mtext.push_back( "" );
+    mcolumns = 0;
 
     if ( ntext.str().empty() )
 	return;
@@ -96,6 +100,8 @@ void NCtext::lset( const NCstring & ntext )
 
 	mtext.back() = NCstring( mtext.back().str() + text.substr( spos ) );
     }
+
+    updateColumns();
 }
 
 
@@ -103,6 +109,7 @@ void NCtext::lset( const NCstring & ntext )
 void NCtext::lbrset( const NCstring & ntext, size_t columns )
 {
     mtext.clear();
+    mcolumns = 0;
 
     if ( ntext.str().empty() )
 	return;
@@ -148,6 +155,8 @@ void NCtext::lbrset( const NCstring & ntext, size_t columns )
     {
 	mtext.push_back( NCstring( text.substr( spos ) ) );
     }
+
+    updateColumns();
 }
 
 
@@ -167,35 +176,24 @@ unsigned NCtext::Lines() const
 void NCtext::append( const NCstring &line )
 {
     mtext.push_back( line );
+    mcolumns = std::max( mcolumns, NCwidth::columns( line.str(), NCurses::tabsize() ) );
 }
 
 
 
-size_t NCtext::Columns() const
+void NCtext::updateColumns()
 {
-    size_t llen = 0;		// longest line
-    size_t tmp_len = 0;		// width of current line
+    mcolumns = 0;
 
-    const_iterator line;		// iterator for list <NCstring> mtext
-    std::wstring::const_iterator wstr_it;	// iterator for std::wstring
-
-    for ( line = mtext.begin(); line != mtext.end(); ++line )
-    {
-	tmp_len = 0;
+    for ( const_iterator line = mtext.begin(); line != mtext.end(); ++line )
+	mcolumns = std::max( mcolumns, NCwidth::columns( ( *line ).str(), NCurses::tabsize() ) );
+}
 
-	for ( wstr_it = ( *line ).str().begin(); wstr_it != ( *line ).str().end() ; ++wstr_it )
-	{
-	    if ( iswprint( *wstr_it ) )
-		tmp_len += wcwidth( *wstr_it );
-	    else if ( *wstr_it == L'\t' )
-		tmp_len += NCurses::tabsize();
-	}
 
-	if ( tmp_len > llen )
-	    llen = tmp_len;
-    }
 
-    return llen;
+size_t NCtext::Columns() const
+{
+    return mcolumns;
 }
 
 
@@ -238,6 +236,8 @@ void NClabel::stripHotkey()
 	    break;
 	}
     }
+
+    updateColumns();	// the hotkey marker is gone
 }
 
 
@@ -52,6 +52,11 @@ protected:
 
     std::list<NCstring> mtext;
 
+    /** The width of the longest line, updated when the text changes. */
+    size_t mcolumns;
+
+    void updateColumns();
+
     virtual void lset( const NCstring & ntext );
     void lbrset( const NCstring & ntext, size_t columns );
 
@@ -29,6 +29,7 @@
 #include <fstream>
 #include <list>
 #include <set>
+#include <algorithm>
 
 #include <yui/Libyui_config.h>
 
@@ -50,6 +51,7 @@ using stdutil::form;
 
 NCurses * NCurses::myself = 0;
 std::set<NCDialog*> NCurses::_knownDlgs;
+std::list<NCIdleHandler*> NCurses::_idleHandlers;
 const NCursesEvent NCursesEvent::Activated( NCursesEvent::button, YEvent::Activated );
 const NCursesEvent NCursesEvent::SelectionChanged( NCursesEvent::button, YEvent::SelectionChanged );
 const NCursesEvent NCursesEvent::ValueChanged( NCursesEvent::button, YEvent::ValueChanged );
@@ -552,6 +554,40 @@ void NCurses::ForgetDlg( NCDialog * dlg_r )
 }
 
 
+void NCurses::AddIdleHandler( NCIdleHandler * handler )
+{
+    if ( handler
+	 && std::find( _idleHandlers.begin(), _idleHandlers.end(), handler ) == _idleHandlers.end() )
+    {
+	_idleHandlers.push_back( handler );
+    }
+}
+
+
+
+void NCurses::RemoveIdleHandler( NCIdleHandler * handler )
+{
+    _idleHandlers.remove( handler );
+}
+
+
+
+void NCurses::RunIdleHandlers()
+{
+    // a handler might add or remove handlers
+    std::list<NCIdleHandler*> handlers( _idleHandlers );
+
+    for ( std::list<NCIdleHandler*>::iterator it = handlers.begin(); it != handlers.end(); ++it )
+    {
+	if ( std::find( _idleHandlers.begin(), _idleHandlers.end(), *it ) == _idleHandlers.end() )
+	    continue;
+
+	if ( !( *it )->idle() )
+	    RemoveIdleHandler( *it );
+    }
+}
+
+
 /*
  * Redirects stderr and stdout to /dev/null
  *
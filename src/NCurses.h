@@ -29,6 +29,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <list>
 
 #include <yui/YEvent.h>
 #include <yui/YWidget.h>
@@ -45,6 +46,7 @@
 
 class NCWidget;
 class NCDialog;
+class NCIdleHandler;
 
 
 class NCursesError
@@ -216,8 +218,36 @@ public:
     void RedirectToLog();
     static void ResizeEvent();
 
+public:
+    // work done while waiting for user input (see NCIdleHandler)
+    static void AddIdleHandler( NCIdleHandler * handler );
+    static void RemoveIdleHandler( NCIdleHandler * handler );
+    static bool HaveIdleHandlers() { return !_idleHandlers.empty(); }
+    static void RunIdleHandlers();
+
 private:
     static std::set<NCDialog*> _knownDlgs;
+    static std::list<NCIdleHandler*> _idleHandlers;
+};
+
+
+/**
+ * Work to be done in slices while the UI waits for user input, e.g.
+ * applying the result of a job running in a worker thread. Handlers
+ * are called from the UI thread (see NCDialog::getch), so they may
+ * draw.
+ */
+class NCIdleHandler
+{
+public:
+
+    virtual ~NCIdleHandler() { NCurses::RemoveIdleHandler( this ); }
+
+    /**
+     * Do a short slice of work. Return \c false if there is nothing
+     * left to do; the handler is removed then.
+     */
+    virtual bool idle() = 0;
 };
 
 
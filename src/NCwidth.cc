@@ -0,0 +1,123 @@
+/*
+  Copyright (C) 2000-2012 Novell, Inc
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) version 3.0 of the License. This library
+  is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+  License for more details. You should have received a copy of the GNU
+  Lesser General Public License along with this library; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+  Floor, Boston, MA 02110-1301 USA
+*/
+
+
+/*-/
+
+   File:       NCwidth.cc
+
+/-*/
+
+#include <wchar.h>		// wcwidth
+#include <wctype.h>		// iswprint
+#include <algorithm>
+#include <atomic>
+
+#include "NCwidth.h"
+
+
+static const unsigned blockBits = 8;
+static const unsigned blockSize = 1 << blockBits;
+static const unsigned maxChar	= 0x110000;
+
+// The first level of the table: a block of widths per 256 characters,
+// built on first use. The blocks live as long as the program. Labels
+// are also measured by the sort workers (see NCTableCol::recode), so
+// a block is published by compare-exchange.
+static std::atomic<signed char *> blocks[ maxChar >> blockBits ];
+
+
+static signed char * buildBlock( unsigned first )
+{
+    signed char * block = new signed char[ blockSize ];
+
+    for ( unsigned i = 0; i < blockSize; ++i )
+    {
+	wchar_t wc = first + i;
+	block[i] = iswprint( wc ) ? wcwidth( wc ) : -1;
+    }
+
+    return block;
+}
+
+
+int NCwidth::lookup( wchar_t wc )
+{
+    unsigned c = wc;
+
+    if ( c >= maxChar )
+	return -1;
+
+    std::atomic<signed char *> & slot = blocks[ c >> blockBits ];
+    signed char * block = slot.load( std::memory_order_acquire );
+
+    if ( !block )
+    {
+	signed char * built = buildBlock( c & ~( blockSize - 1 ) );
+
+	if ( slot.compare_exchange_strong( block, built, std::memory_order_acq_rel ) )
+	    block = built;
+	else
+	    delete [] built;	// another thread was faster: use its block
+    }
+
+    return block[ c & ( blockSize - 1 ) ];
+}
+
+
+// Whether the 8 characters at wstr are printable ASCII. Without
+// branches, so the compiler can vectorize it.
+static inline bool printableAscii8( const wchar_t * wstr )
+{
+    unsigned bad = 0;
+
+    for ( unsigned i = 0; i < 8; ++i )
+	bad |= ( ( unsigned )wstr[i] - 0x20u >= 0x5fu );
+
+    return !bad;
+}
+
+
+size_t NCwidth::columns( const wchar_t * wstr, size_t len, unsigned tabsize )
+{
+    const wchar_t * ech = wstr + len;
+    size_t cols = 0;
+
+    while ( wstr < ech )
+    {
+	// printable ASCII takes one column per character
+	const wchar_t * ascii = wstr;
+
+	while ( ech - wstr >= 8 && printableAscii8( wstr ) )
+	    wstr += 8;
+
+	while ( wstr < ech && printableAscii( *wstr ) )
+	    ++wstr;
+
+	cols += wstr - ascii;
+
+	if ( wstr == ech )
+	    break;
+
+	if ( *wstr == L'\t' )
+	    cols += tabsize;
+	else
+	    cols += std::max( 0, lookup( *wstr ) );
+
+	++wstr;
+    }
+
+    return cols;
+}
@@ -0,0 +1,72 @@
+/*
+  Copyright (C) 2000-2012 Novell, Inc
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) version 3.0 of the License. This library
+  is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+  License for more details. You should have received a copy of the GNU
+  Lesser General Public License along with this library; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+  Floor, Boston, MA 02110-1301 USA
+*/
+
+
+/*-/
+
+   File:       NCwidth.h
+
+/-*/
+
+#ifndef NCwidth_h
+#define NCwidth_h
+
+#include <cstddef>
+#include <string>
+
+
+/**
+ * The display width of wide characters, as iswprint and wcwidth tell
+ * for the current locale. Printable ASCII is handled inline, other
+ * characters are looked up in a two-level table, which is filled in
+ * blocks of 256 characters on first use.
+ **/
+class NCwidth
+{
+public:
+
+    /** The columns of \a wc, -1 if it is not printable (like wcwidth). */
+    static int of( wchar_t wc )
+    {
+	if ( printableAscii( wc ) )
+	    return 1;
+
+	return lookup( wc );
+    }
+
+    /**
+     * The columns needed to print the \a len characters at \a wstr.
+     * Tabs take \a tabsize columns, other non printable characters
+     * none.
+     **/
+    static size_t columns( const wchar_t * wstr, size_t len, unsigned tabsize );
+
+    static size_t columns( const std::wstring & wstr, unsigned tabsize )
+    {
+	return columns( wstr.data(), wstr.size(), tabsize );
+    }
+
+    static bool printableAscii( wchar_t wc )
+    {
+	return ( unsigned )wc - 0x20u < 0x5fu;
+    }
+
+private:
+
+    static int lookup( wchar_t wc );
+};
+
+
+#endif // NCwidth_h